@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "specs/arena.h"
+
+// every allocation starts at a multiple of this
+#define ARENA_ALIGN 16
+
+/*
+	arena.c
+
+	bump allocator for world memory. Blocks are chained in
+	the order they were first used; a mark is the number of
+	bytes of every block before the current one plus what
+	is used of the current one, so it stays valid however
+	many blocks there are.
+ */
+
+struct arena_block {
+	arena_block *next;
+	size_t start; // mark of the first byte of the block
+	size_t size;
+	size_t used;
+	char *data;
+};
+
+//Prototypes for static functions
+static arena_block *arena_block_new (size_t start, size_t size);
+static void arena_blocks_free (arena_block *block);
+
+/*
+	mallocs a block
+
+	Parameters:
+		start = mark of its first byte
+		size = usable bytes
+
+	Returns: the empty block
+ */
+static arena_block *
+arena_block_new (size_t start, size_t size) {
+
+	arena_block *block = (arena_block *)malloc(sizeof(arena_block));
+	if (block != NULL)
+		block->data = (char *)malloc(size);
+
+	if (block == NULL || block->data == NULL) {
+		printf("Memory allocation error: in function arena_block_new\n");
+		exit(-1);
+	}
+
+	block->next = NULL;
+	block->start = start;
+	block->size = size;
+	block->used = 0;
+
+	return block;
+}
+
+/*
+	frees a block and every block after it
+
+	Parameters:
+		*block = first block to free, may be NULL
+ */
+static void
+arena_blocks_free (arena_block *block) {
+
+	while (block != NULL) {
+
+		arena_block *next = block->next;
+		free (block->data);
+		free (block);
+		block = next;
+	}
+}
+
+/*
+	creates an arena with one empty block
+
+	Parameters:
+		block_size = bytes per block
+
+	Returns: the arena
+ */
+arena *
+arena_new (size_t block_size) {
+
+	arena *new_arena = (arena *)malloc(sizeof(arena));
+	if (new_arena == NULL) {
+		printf("Memory allocation error: in function arena_new\n");
+		exit(-1);
+	}
+
+	new_arena->block_size = block_size;
+	new_arena->first = arena_block_new (0, block_size);
+	new_arena->current = new_arena->first;
+
+	return new_arena;
+}
+
+/*
+	allocates from the current block, moving on to the
+	next one, or a new one, when it is full
+
+	Parameters:
+		*arena = arena to allocate from
+		size = bytes needed
+
+	Returns: aligned memory, valid until the arena is
+	rewound past it or freed
+ */
+void *
+arena_alloc (arena *arena, size_t size) {
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	arena_block *block = arena->current;
+
+	if (block->used + size > block->size) {
+
+		size_t start = block->start + block->size;
+
+		// blocks kept from before a rewind are reused if they are big
+		// enough; otherwise they go, as the marks after them would move
+		if (block->next == NULL || block->next->size < size) {
+
+			arena_blocks_free (block->next);
+			block->next = arena_block_new (start, size > arena->block_size ? size : arena->block_size);
+		}
+
+		block = block->next;
+		block->used = 0;
+		arena->current = block;
+	}
+
+	void *memory = block->data + block->used;
+	block->used += size;
+
+	return memory;
+}
+
+/*
+	Returns: the mark of the next allocation
+ */
+size_t
+arena_mark (arena *arena) {
+
+	return arena->current->start + arena->current->used;
+}
+
+/*
+	makes the block holding mark the current one again, with
+	everything after mark unused
+
+	Parameters:
+		*arena = arena to rewind
+		mark = value returned by arena_mark
+ */
+void
+arena_rewind (arena *arena, size_t mark) {
+
+	arena_block *block = arena->first;
+
+	while (block->next != NULL && mark > block->start + block->size)
+		block = block->next;
+
+	block->used = mark - block->start;
+	arena->current = block;
+}
+
+/*
+	frees the arena and all of its blocks
+
+	Parameters:
+		*arena = arena to free
+ */
+void
+arena_free (arena *arena) {
+
+	arena_blocks_free (arena->first);
+	free (arena);
+}
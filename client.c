@@ -48,7 +48,8 @@ typedef struct {
     int socket;
     float *angles;
     cpVect *positions;
-    int num_bodies;
+    int num_positions; // length of angles and positions
+    int num_bodies; // one past the highest body id received
     bool terminate_thread;
     pthread_mutex_t *space_lock;
     pthread_mutex_t *socket_lock;
@@ -58,6 +59,7 @@ typedef struct {
     bool draw_success;
     GtkTextBuffer *textbox_buffer;
     GtkWidget *label;
+    double last_ping;
 } gui_world;
 
 /*
@@ -71,8 +73,23 @@ typedef struct {
     ssize_t n; // Number of bytes read (last index in buffer that is filled)
 } string_info;
 
+/*
+	body_search struct
+
+	the id of a body to look for in the space, and the
+	body once it is found
+ */
+typedef struct {
+    int body_id;
+    cpBody *body;
+} body_search;
+
 //function prototypes
 static string_info *client_select(int socket);
+static void find_body (cpBody *body, body_search *search);
+static void remove_shape (cpBody *body, cpShape *shape, cpSpace *space);
+static void remove_body (gui_world *world, int body_id);
+static void client_ping(gui_world *world);
 static void initialize_array (gui_world *world);
 
 /*
@@ -154,7 +171,10 @@ add_user_point (float x, float y, gui_world *world) {
 		world->draw_success = false;
     }
 
+    pthread_mutex_lock(world -> space_lock);
     world->graphics->user_points = g_array_append_vals(world->graphics->user_points, &point, 1);
+    graphics_stroke_append (world->graphics);
+    pthread_mutex_unlock(world -> space_lock);
 }
 
 /*
@@ -170,7 +190,8 @@ update_body_post (cpSpace *space, cpBody *body, gui_world *world) {
     body_information *info = cpBodyGetUserData (body);
     int index = info->body_id;
 
-    if ((index < world->num_bodies) && (fabs(world->angles[index]) < 1000)) {
+    if ((index >= 0) && (index < world->num_bodies) && (index < world->num_positions)
+        && (fabs(world->angles[index]) < 1000)) {
 		
 		cpBodySetPos (body, world->positions[index]);
 		cpBodySetAngle (body, world->angles[index]);
@@ -194,15 +215,17 @@ update_body (cpBody *body, gui_world *world) {
 /*
 	updates the space
 
-	parameters: gui world, array of float angles, array of cpVects
+	parameters: gui world, array of float angles, array of cpVects,
+		length of the arrays
 
 	returns: nothing
  */
 static void 
-update_space (gui_world *world, float *angles, cpVect *positions) {
+update_space (gui_world *world, float *angles, cpVect *positions, int count) {
 
     world->angles = angles;
     world->positions = positions;
+    world->num_positions = count;
     cpSpaceEachBody(world->space, (cpSpaceBodyIteratorFunc) update_body, world);
 }
 
@@ -230,7 +253,14 @@ add_body (gui_world *world, char *message) {
 
     info->color = conv_color (polygon->color);
     info->body_id = polygon->body_id;
-	(world->num_bodies)++;
+    info->outline = NULL;
+    info->outline_count = 0;
+
+	// ids are not dense once a body left the world, so the updates are
+	// bounded by the highest one
+	if (info->body_id >= world->num_bodies)
+		world->num_bodies = info->body_id + 1;
+
     cpBodySetUserData (body, info);
 
     cpSpaceAddShape (world->space, cpSegmentShapeNew
@@ -244,6 +274,62 @@ add_body (gui_world *world, char *message) {
 
 }
 
+/*
+	remembers the body if it has the id searched for
+	used as an iterator in remove_body()
+
+	parameters: cpBody pointer, body_search pointer
+
+	returns: nothing
+ */
+static void 
+find_body (cpBody *body, body_search *search) {
+
+    body_information *info = cpBodyGetUserData (body);
+
+    if (info != NULL && info->body_id == search->body_id)
+		search->body = body;
+}
+
+/*
+	takes a shape out of the space and frees it
+	used as an iterator in remove_body()
+
+	parameters: cpBody pointer, cpShape pointer, cpSpace pointer
+
+	returns: nothing
+ */
+static void 
+remove_shape (cpBody *body, cpShape *shape, cpSpace *space) {
+
+    cpSpaceRemoveShape (space, shape);
+    cpShapeFree (shape);
+}
+
+/*
+	removes the body the server removed for leaving the level
+
+	parameters: gui world, id of the body
+
+	returns: nothing
+ */
+static void 
+remove_body (gui_world *world, int body_id) {
+
+    body_search search = { body_id, NULL };
+
+    cpSpaceEachBody (world->space, (cpSpaceBodyIteratorFunc) find_body, &search);
+
+    if (search.body == NULL)
+		return;
+
+    cpBodyEachShape (search.body, (cpBodyShapeIteratorFunc) remove_shape, world->space);
+    cpSpaceRemoveBody (world->space, search.body);
+
+    free (cpBodyGetUserData (search.body));
+    cpBodyFree (search.body);
+}
+
 /*
 	listening thread that checks for new data from server
 
@@ -266,6 +352,12 @@ listener_thread(void *data) {
 			if(info->buffer)
 				memcpy(string, info->buffer, MAXLINE);
 
+			if (info -> n > 0) {
+				pthread_mutex_lock(world -> space_lock);
+				graphics_hud_received (world->graphics, info -> n);
+				pthread_mutex_unlock(world -> space_lock);
+			}
+
 			if (string[ID_INDEX] == NEW_BODY_MESSAGE + '0') {
 			
 				pthread_mutex_lock(world -> space_lock);
@@ -275,9 +367,17 @@ listener_thread(void *data) {
 
 			else if (string[ID_INDEX] == UPDATE_POSITIONS_MESSAGE + '0') {
 				
+				// only pay for the clock reads while the overlay is shown
+				bool timed = world->graphics->hud.visible;
+				double start = timed ? graphics_hud_now () : 0;
+
 				coord_update *coords = protocol_extract_coords (string);
+				double decoded = timed ? graphics_hud_now () : 0;
+
 				pthread_mutex_lock(world -> space_lock);
-				update_space(world, coords->angle_array, coords->vector_array);
+				update_space(world, coords->angle_array, coords->vector_array, coords->count);
+				if (timed)
+					graphics_hud_snapshot (world->graphics, decoded - start, graphics_hud_now () - decoded);
 				pthread_mutex_unlock(world -> space_lock);
 				
 				free(coords->angle_array);
@@ -285,6 +385,19 @@ listener_thread(void *data) {
 				free(coords);
 			}
 
+			else if (string[ID_INDEX] == REMOVE_BODY_MESSAGE + '0') {
+
+				int count;
+				int *ids = protocol_extract_removals (string, &count);
+
+				pthread_mutex_lock(world -> space_lock);
+				for (int i = 0; i < count; i++)
+					remove_body (world, ids[i]);
+				pthread_mutex_unlock(world -> space_lock);
+
+				free(ids);
+			}
+
 			else if (string[ID_INDEX] == CHAT_MESSAGE + '0') {
 			
 				char *label_string = protocol_decode_chat(string);
@@ -308,8 +421,19 @@ listener_thread(void *data) {
 				world -> try_number = level_switch_info -> try_number;
 				new_game(world);
 			}
+
+			else if (string[ID_INDEX] == PING_MESSAGE + '0') {
+
+				double sent = protocol_decode_ping(string);
+				pthread_mutex_lock(world -> space_lock);
+				graphics_hud_rtt (world->graphics, graphics_hud_now () - sent);
+				pthread_mutex_unlock(world -> space_lock);
+			}
 		}
 
+		if (world->graphics->hud.visible)
+			client_ping(world);
+
 		gtk_widget_queue_draw(world -> graphics -> window); 
 		usleep(m_secs);
 		free(info);
@@ -318,6 +442,33 @@ listener_thread(void *data) {
     return NULL;
 }
 
+/*
+	sends a ping to the server once a second so the
+	performance overlay can show the round trip time
+
+	parameters: gui world struct pointer
+
+	returns: nothing
+ */
+static void
+client_ping(gui_world *world) {
+
+    double now = graphics_hud_now ();
+
+    if (now - world->last_ping < 1)
+		return;
+
+    world->last_ping = now;
+
+    char *send_message = protocol_send_ping(now);
+
+    pthread_mutex_lock(world -> socket_lock);
+    sendall(world->socket, send_message, MAXLINE);
+    pthread_mutex_unlock(world -> socket_lock);
+
+    free(send_message);
+}
+
 /*
 	gets a message from the socket
 
@@ -339,6 +490,8 @@ client_select(int socket) {
 	    exit(-1);
 	}
 
+    result -> n = 0;
+
     // Set time limit.
     timeout.tv_sec = 0;
     timeout.tv_usec = 1;
@@ -477,19 +630,14 @@ static gboolean
 cb_button_press (GtkWidget *widget, GdkEventButton *event, gpointer data) {
 
     gui_world *world = (gui_world *)data;
-    int space_height = 50, space_width = 50;
+	world->draw_success = true;
 
     /* convert into cp values */
-    int window_height = gtk_widget_get_allocated_height(world -> graphics -> drawing_screen);
-    int window_width = gtk_widget_get_allocated_width(world -> graphics -> drawing_screen);
-
-    float screen_height_ratio = (float) window_height / space_height;
-    float screen_width_ratio = (float) window_width / space_width;
-
-	world->draw_success = true;
+    cpVect point = graphics_screen_to_world (world -> graphics, event->x, event->y);
+    cpFloat x = point.x;
+    cpFloat y = point.y;
 
-    cpFloat x = (event->x - window_width / 2) / screen_width_ratio;
-    cpFloat y = (-event->y + window_height / 2) / screen_height_ratio;
+    gtk_widget_grab_focus (widget);
 
 
 	if (isnan(x) || isnan(y)) {
@@ -516,6 +664,7 @@ static void
 initialize_array (gui_world *world) {
 
     world->graphics->user_points = g_array_new (FALSE, FALSE, sizeof(cpVect));
+    graphics_stroke_clear (world->graphics);
 }
 
 /*
@@ -639,17 +788,10 @@ motion_notify_event_cb (GtkWidget *widget, GdkEventMotion *event, gpointer data)
 
     gdk_window_get_pointer (event->window, &x, &y, &state);
 
-    int space_height = 50, space_width = 50;
-
     /* convert into cp values */
-    int window_height = gtk_widget_get_allocated_height(world -> graphics -> drawing_screen);
-    int window_width = gtk_widget_get_allocated_width(world -> graphics -> drawing_screen);
-
-    float screen_height_ratio = (float) window_height / space_height;
-    float screen_width_ratio = (float) window_width / space_width;
-
-    cpFloat x1 = (x - window_width / 2) / screen_width_ratio;
-    cpFloat y1 = (-y + window_height / 2) / screen_height_ratio;
+    cpVect point = graphics_screen_to_world (world -> graphics, x, y);
+    cpFloat x1 = point.x;
+    cpFloat y1 = point.y;
 
 
     if (state & GDK_BUTTON1_MASK) 
@@ -658,6 +800,50 @@ motion_notify_event_cb (GtkWidget *widget, GdkEventMotion *event, gpointer data)
     return TRUE;
 }
 
+/*
+	callback function for the camera keys and the h key,
+	which toggles the performance overlay; active while
+	the drawing area has focus
+
+	parameters: gtk widget, key event and gpointer data, as gtk desires
+
+	returns: gboolean
+ */
+static gboolean 
+cb_key_press (GtkWidget *widget, GdkEventKey *event, gpointer data) {
+
+    gui_world *world = (gui_world *)data;
+
+    pthread_mutex_lock(world -> space_lock);
+    gboolean handled = TRUE;
+    if (event->keyval == GDK_KEY_h)
+		graphics_hud_toggle (world->graphics);
+    else
+		handled = graphics_camera_key (world->graphics, event->keyval);
+    pthread_mutex_unlock(world -> space_lock);
+
+    return handled;
+}
+
+/*
+	callback function for zooming with the scroll wheel
+
+	parameters: gtk widget, scroll event and gpointer data, as gtk desires
+
+	returns: gboolean
+ */
+static gboolean 
+cb_scroll (GtkWidget *widget, GdkEventScroll *event, gpointer data) {
+
+    gui_world *world = (gui_world *)data;
+
+    pthread_mutex_lock(world -> space_lock);
+    gboolean handled = graphics_camera_scroll (world->graphics, event->direction, event->x, event->y);
+    pthread_mutex_unlock(world -> space_lock);
+
+    return handled;
+}
+
 /*
 	main function. initializes gtk, starts the threads
 
@@ -691,13 +877,7 @@ main(int argc, char **argv) {
     }
 
     gui_world world;
-    world.graphics = (graphics_world *) malloc(sizeof(graphics_world));
-   
-	if (world.graphics == NULL) {
-
-		printf("Memory allocation error: in function main\n");
-		exit(-1);
-	}
+    world.graphics = graphics_world_new ();
 
 	world.graphics->display = false;
     world.graphics->color = conv_color("red");
@@ -705,6 +885,7 @@ main(int argc, char **argv) {
     world.space = world.graphics->space = cpSpaceNew();
     world.socket = sockfd;
     world.try_number = 0;
+    world.last_ping = 0;
     pthread_mutex_t mutex_lock = PTHREAD_MUTEX_INITIALIZER;
     world.space_lock = &mutex_lock;
     pthread_mutex_t network_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -717,10 +898,9 @@ main(int argc, char **argv) {
 	world.graphics->message = NULL;
 	world.angles = NULL;
 	world.positions = NULL;
+	world.num_positions = 0;
 	world.num_bodies = 0;
 
-    initialize_array(&world);
-
     GtkWidget *frame;
     GtkWidget *da;
     GtkWidget *vbox;
@@ -836,6 +1016,8 @@ main(int argc, char **argv) {
     gtk_widget_add_events(da, GDK_BUTTON_PRESS_MASK);
     gtk_widget_add_events(da, GDK_BUTTON_RELEASE_MASK);
     gtk_widget_add_events(da, GDK_POINTER_MOTION_MASK | GDK_POINTER_MOTION_HINT_MASK);
+    gtk_widget_add_events(da, GDK_KEY_PRESS_MASK | GDK_SCROLL_MASK);
+    gtk_widget_set_can_focus(da, TRUE);
 
 //---------------------------------
 
@@ -865,6 +1047,8 @@ main(int argc, char **argv) {
     g_signal_connect (da, "motion-notify-event", G_CALLBACK (motion_notify_event_cb), &world);
     g_signal_connect (da, "button-press-event", G_CALLBACK (cb_button_press), &world);
     g_signal_connect (da, "button-release-event", G_CALLBACK (cb_button_release), &world);
+    g_signal_connect (da, "key-press-event", G_CALLBACK (cb_key_press), &world);
+    g_signal_connect (da, "scroll-event", G_CALLBACK (cb_scroll), &world);
 
     gtk_widget_show_all (world.graphics -> window);
 
@@ -873,6 +1057,7 @@ main(int argc, char **argv) {
     gtk_main();
 
 	world_free_space (world.space);
+	graphics_world_free (world.graphics);
 
     return 0;
 }
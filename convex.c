@@ -0,0 +1,462 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <chipmunk/chipmunk.h>
+#include "specs/convex.h"
+
+// outlines with less area than this are treated as lines
+#define CONVEX_EPSILON 1e-6
+
+/*
+	convex.c
+
+	decomposes simple polygons into convex pieces by ear
+	clipping followed by Hertel-Mehlhorn merging. Works in
+	counter clockwise order internally and hands the pieces
+	out clockwise, the way cpPolyShape wants them.
+ */
+
+//Prototypes for static functions
+static int convex_clean (cpVect *outline, int count, cpVect *points);
+static bool convex_simple (cpVect *points, int count);
+static bool convex_segments_cross (cpVect a, cpVect b, cpVect c, cpVect d);
+static bool convex_inside_triangle (cpVect p, cpVect a, cpVect b, cpVect c);
+static bool convex_is_convex (cpVect *points, int *piece, int size);
+static int convex_merge (cpVect *points, int *first, int first_size, int *second, int second_size, int *merged);
+
+/*
+	copies an outline without repeated points and without
+	points that lie on the line through their neighbours
+
+	Parameters:
+		*outline = polygon to clean
+		count = number of points
+		*points = room for count points
+
+	Returns: number of points written
+ */
+static int
+convex_clean (cpVect *outline, int count, cpVect *points) {
+
+	int size = 0;
+
+	for (int i = 0; i < count; i++)
+		if (size == 0 || !cpveql (outline[i], points[size - 1]))
+			points[size++] = outline[i];
+
+	while (size > 1 && cpveql (points[0], points[size - 1]))
+		size--;
+
+	// dropping a point can make its neighbours collinear, so repeat
+	bool dropped = true;
+
+	while (dropped && size >= 3) {
+
+		dropped = false;
+
+		for (int i = 0; i < size && size >= 3; i++) {
+
+			cpVect a = points[(i + size - 1) % size];
+			cpVect b = points[i];
+			cpVect c = points[(i + 1) % size];
+
+			if (cpfabs (cpvcross (cpvsub (b, a), cpvsub (c, b))) < CONVEX_EPSILON) {
+				memmove (points + i, points + i + 1, (size - i - 1) * sizeof(cpVect));
+				size--;
+				dropped = true;
+				i--;
+			}
+		}
+	}
+
+	return size;
+}
+
+/*
+	checks whether two segments touch or cross
+
+	Parameters: endpoints of the first and of the second segment
+
+	Returns: true if they have a point in common
+ */
+static bool
+convex_segments_cross (cpVect a, cpVect b, cpVect c, cpVect d) {
+
+	cpFloat d1 = cpvcross (cpvsub (b, a), cpvsub (c, a));
+	cpFloat d2 = cpvcross (cpvsub (b, a), cpvsub (d, a));
+	cpFloat d3 = cpvcross (cpvsub (d, c), cpvsub (a, c));
+	cpFloat d4 = cpvcross (cpvsub (d, c), cpvsub (b, c));
+
+	if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0)))
+		return true;
+
+	// collinear cases: an endpoint lying on the other segment
+	cpBB first = cpBBNew (cpfmin (a.x, b.x), cpfmin (a.y, b.y), cpfmax (a.x, b.x), cpfmax (a.y, b.y));
+	cpBB second = cpBBNew (cpfmin (c.x, d.x), cpfmin (c.y, d.y), cpfmax (c.x, d.x), cpfmax (c.y, d.y));
+
+	return (d1 == 0 && cpBBContainsVect (first, c)) || (d2 == 0 && cpBBContainsVect (first, d))
+		|| (d3 == 0 && cpBBContainsVect (second, a)) || (d4 == 0 && cpBBContainsVect (second, b));
+}
+
+/*
+	checks that no two edges of a cleaned outline meet
+	anywhere but at their shared corner
+
+	Parameters:
+		*points = cleaned outline
+		count = number of points
+
+	Returns: true if the outline is a simple polygon
+ */
+static bool
+convex_simple (cpVect *points, int count) {
+
+	for (int i = 0; i < count; i++) {
+		for (int j = i + 2; j < count; j++) {
+
+			// the last edge shares a corner with the first
+			if (i == 0 && j == count - 1)
+				continue;
+
+			if (convex_segments_cross (points[i], points[(i + 1) % count], points[j], points[(j + 1) % count]))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+	checks whether a point lies in or on a counter
+	clockwise triangle
+
+	Parameters: the point and the corners of the triangle
+
+	Returns: true if it does
+ */
+static bool
+convex_inside_triangle (cpVect p, cpVect a, cpVect b, cpVect c) {
+
+	return cpvcross (cpvsub (b, a), cpvsub (p, a)) >= 0
+		&& cpvcross (cpvsub (c, b), cpvsub (p, b)) >= 0
+		&& cpvcross (cpvsub (a, c), cpvsub (p, c)) >= 0;
+}
+
+/*
+	checks whether a counter clockwise piece is convex
+
+	Parameters:
+		*points = cleaned outline
+		*piece = indices of the corners of the piece
+		size = number of corners
+
+	Returns: true if no corner turns clockwise
+ */
+static bool
+convex_is_convex (cpVect *points, int *piece, int size) {
+
+	for (int i = 0; i < size; i++) {
+
+		cpVect a = points[piece[i]];
+		cpVect b = points[piece[(i + 1) % size]];
+		cpVect c = points[piece[(i + 2) % size]];
+
+		if (cpvcross (cpvsub (b, a), cpvsub (c, b)) < 0)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+	joins two pieces along the edge they share if the
+	result is convex
+
+	Parameters:
+		*points = cleaned outline
+		*first, first_size = corners of the first piece
+		*second, second_size = corners of the second piece
+		*merged = room for first_size + second_size corners
+
+	Returns: number of corners of the merged piece, or 0 if
+	the pieces share no edge or would not stay convex
+ */
+static int
+convex_merge (cpVect *points, int *first, int first_size, int *second, int second_size, int *merged) {
+
+	for (int i = 0; i < first_size; i++) {
+
+		int u = first[i];
+		int v = first[(i + 1) % first_size];
+
+		for (int j = 0; j < second_size; j++) {
+
+			if (second[j] != v || second[(j + 1) % second_size] != u)
+				continue;
+
+			// first from v around to u, then second between u and v
+			int size = 0;
+
+			for (int k = 0; k < first_size; k++)
+				merged[size++] = first[(i + 1 + k) % first_size];
+
+			for (int k = 2; k < second_size; k++)
+				merged[size++] = second[(j + k) % second_size];
+
+			return convex_is_convex (points, merged, size) ? size : 0;
+		}
+	}
+
+	return 0;
+}
+
+/*
+	Decomposes an outline into convex pieces.
+
+	Parameters:
+		*outline = polygon to decompose
+		count = number of points
+
+	Returns: the pieces, or NULL if the outline cannot be used
+ */
+convex_pieces *
+convex_decompose (cpVect *outline, int count) {
+
+	if (count < 3)
+		return NULL;
+
+	cpVect points[count];
+	int size = convex_clean (outline, count, points);
+
+	if (size < 3 || !convex_simple (points, size))
+		return NULL;
+
+	cpFloat area = 0;
+	for (int i = 0; i < size; i++)
+		area += cpvcross (points[i], points[(i + 1) % size]);
+
+	if (cpfabs (area) < CONVEX_EPSILON)
+		return NULL;
+
+	// ear clipping below wants counter clockwise
+	if (area < 0) {
+		for (int i = 0; i < size / 2; i++) {
+			cpVect swap = points[i];
+			points[i] = points[size - 1 - i];
+			points[size - 1 - i] = swap;
+		}
+	}
+
+	// every piece has room for all corners, since merging only grows them
+	int *pieces = (int *)malloc(size * size * sizeof(int));
+	int *piece_sizes = (int *)malloc(size * sizeof(int));
+	int *merged = (int *)malloc(2 * size * sizeof(int));
+	int remaining[size];
+
+	if (pieces == NULL || piece_sizes == NULL || merged == NULL) {
+		printf("Memory allocation error: in function convex_decompose\n");
+		exit(-1);
+	}
+
+	int left = size;
+	int piece_count = 0;
+
+	for (int i = 0; i < size; i++)
+		remaining[i] = i;
+
+	while (left > 3) {
+
+		bool clipped = false;
+
+		for (int k = 0; k < left && !clipped; k++) {
+
+			int a = remaining[(k + left - 1) % left];
+			int b = remaining[k];
+			int c = remaining[(k + 1) % left];
+
+			if (cpvcross (cpvsub (points[b], points[a]), cpvsub (points[c], points[b])) <= 0)
+				continue;
+
+			bool ear = true;
+
+			for (int m = 0; m < left && ear; m++) {
+
+				int p = remaining[m];
+
+				if (p != a && p != b && p != c)
+					ear = !convex_inside_triangle (points[p], points[a], points[b], points[c]);
+			}
+
+			if (!ear)
+				continue;
+
+			int *triangle = pieces + piece_count * size;
+			triangle[0] = a;
+			triangle[1] = b;
+			triangle[2] = c;
+			piece_sizes[piece_count++] = 3;
+
+			memmove (remaining + k, remaining + k + 1, (left - k - 1) * sizeof(int));
+			left--;
+			clipped = true;
+		}
+
+		// a simple polygon always has an ear; give up on rounding trouble
+		if (!clipped) {
+			free (pieces);
+			free (piece_sizes);
+			free (merged);
+			return NULL;
+		}
+	}
+
+	pieces[piece_count * size] = remaining[0];
+	pieces[piece_count * size + 1] = remaining[1];
+	pieces[piece_count * size + 2] = remaining[2];
+	piece_sizes[piece_count++] = 3;
+
+	// Hertel-Mehlhorn: drop every diagonal that is not needed for convexity
+	bool joined = true;
+
+	while (joined) {
+
+		joined = false;
+
+		for (int i = 0; i < piece_count; i++) {
+			for (int j = i + 1; j < piece_count; j++) {
+
+				int merged_size = convex_merge (points, pieces + i * size, piece_sizes[i],
+												pieces + j * size, piece_sizes[j], merged);
+
+				if (merged_size == 0)
+					continue;
+
+				memcpy (pieces + i * size, merged, merged_size * sizeof(int));
+				piece_sizes[i] = merged_size;
+
+				piece_count--;
+				memcpy (pieces + j * size, pieces + piece_count * size, piece_sizes[piece_count] * sizeof(int));
+				piece_sizes[j] = piece_sizes[piece_count];
+
+				joined = true;
+				j--;
+			}
+		}
+	}
+
+	convex_pieces *result = (convex_pieces *)malloc(sizeof(convex_pieces));
+	int vertex_count = 0;
+
+	for (int i = 0; i < piece_count; i++)
+		vertex_count += piece_sizes[i];
+
+	if (result == NULL) {
+		printf("Memory allocation error: in function convex_decompose\n");
+		exit(-1);
+	}
+
+	result->vertices = (cpVect *)malloc(vertex_count * sizeof(cpVect));
+	result->sizes = (int *)malloc(piece_count * sizeof(int));
+	result->offsets = (int *)malloc(piece_count * sizeof(int));
+
+	if (result->vertices == NULL || result->sizes == NULL || result->offsets == NULL) {
+		printf("Memory allocation error: in function convex_decompose\n");
+		exit(-1);
+	}
+
+	result->piece_count = piece_count;
+	result->area = 0;
+	result->centroid = cpvzero;
+
+	int offset = 0;
+
+	for (int i = 0; i < piece_count; i++) {
+
+		int *piece = pieces + i * size;
+		int piece_size = piece_sizes[i];
+		cpFloat piece_area = 0;
+		cpVect sum = cpvzero;
+
+		for (int k = 0; k < piece_size; k++) {
+
+			cpVect a = points[piece[k]];
+			cpVect b = points[piece[(k + 1) % piece_size]];
+			cpFloat cross = cpvcross (a, b);
+
+			piece_area += cross;
+			sum = cpvadd (sum, cpvmult (cpvadd (a, b), cross));
+
+			// reversed to clockwise
+			result->vertices[offset + piece_size - 1 - k] = a;
+		}
+
+		// sum / (3 * piece_area) is the centroid, weighted by area / 2
+		result->centroid = cpvadd (result->centroid, cpvmult (sum, 1.0 / 6.0));
+		result->area += piece_area / 2;
+
+		result->sizes[i] = piece_size;
+		result->offsets[i] = offset;
+		offset += piece_size;
+	}
+
+	result->centroid = cpvmult (result->centroid, 1.0 / result->area);
+
+	free (pieces);
+	free (piece_sizes);
+	free (merged);
+
+	return result;
+}
+
+/*
+	Computes the moment of inertia of the pieces.
+
+	Parameters:
+		*pieces = decomposed polygon
+		mass = mass of the whole polygon
+		center = point to take the moment about
+
+	Returns: the moment
+ */
+cpFloat
+convex_moment (convex_pieces *pieces, cpFloat mass, cpVect center) {
+
+	cpFloat moment = 0;
+
+	for (int i = 0; i < pieces->piece_count; i++) {
+
+		cpVect *vertices = pieces->vertices + pieces->offsets[i];
+		int size = pieces->sizes[i];
+		cpFloat area = 0;
+
+		for (int k = 0; k < size; k++)
+			area += cpvcross (vertices[(k + 1) % size], vertices[k]);
+
+		area /= 2;
+
+		moment += cpMomentForPoly (mass * area / pieces->area, size, vertices, cpvneg (center));
+	}
+
+	return moment;
+}
+
+/*
+	Releases decomposed pieces.
+
+	Parameters:
+		*pieces = pieces to release
+
+	Returns: nothing
+ */
+void
+convex_free (convex_pieces *pieces) {
+
+	if (pieces == NULL)
+		return;
+
+	free (pieces->vertices);
+	free (pieces->sizes);
+	free (pieces->offsets);
+	free (pieces);
+}
@@ -24,7 +24,7 @@
 	drawing_coordinates struct
 
 	contains data used by graphics_get_shape 
-	and graphics_draw_body for iteration with 
+	and graphics_batch_body for iteration with 
 	Chipmunk
 
  */
@@ -35,105 +35,867 @@ typedef struct {
 } drawing_coordinates;
 
 
+/*
+	render_target struct
+
+	the graphics world being drawn, the cairo context it
+	is drawn into and the size of that context in pixels;
+	either a GTK window or an offscreen image surface
+
+ */
+typedef struct {
+	graphics_world *world;
+	cairo_t *cr;
+	int width;
+	int height;
+	float screen_width_ratio; // pixels per world unit, camera zoom included
+	float screen_height_ratio;
+	cpVect center; // world point at the middle of the target
+} render_target;
+
+/*
+	polygon_batch struct
+
+	collects the screen space outlines of every body
+	of one color, so that the whole color can be filled
+	and stroked with a single cairo call each
+
+ */
+typedef struct {
+	int capacity;
+	int size;
+	cpVect *points;
+	int polygon_capacity;
+	int polygon_count;
+	int *polygon_sizes;
+} polygon_batch;
+
+/*
+	one batch for each COLOR, plus a last one for bodies
+	that have no color information (drawn in black)
+ */
+#define BATCH_COUNT (GREEN + 2)
+#define BATCH_NO_COLOR (GREEN + 1)
+
+#define CAMERA_MIN_ZOOM 0.25
+#define CAMERA_MAX_ZOOM 8
+#define CAMERA_ZOOM_STEP 1.25
+#define CAMERA_PAN_STEP 0.1 // fraction of the visible width or height
+
+static polygon_batch batches[BATCH_COUNT];
+
+/*
+	scratch buffer for the body space outline of the body
+	being batched; reused for every body of every frame
+ */
+static drawing_coordinates body_coords;
+
+/*
+	bodies already batched in the current frame; the
+	viewport query reports every shape, and a body can
+	have several
+ */
+static GHashTable *batched_bodies;
+
 //function prototypes
-static void graphics_set_color_from_body (cairo_t **cr, cpBody *body);
 static void graphics_set_rgb_from_color (cairo_t **cr, COLOR color);
-static void graphics_draw_body (cpBody *body, graphics_world *world);
+static void graphics_batch_body (cpBody *body, render_target *target);
+static void graphics_batch_append (polygon_batch *batch, cpVect point);
+static void graphics_draw_batches (render_target *target);
 static void graphics_get_shape (cpBody *body, cpShape *shape, drawing_coordinates *coords);
-static void graphics_write_message (graphics_world *world);
-static void graphics_draw_zone (graphics_world *world);
-static void graphics_partial_shape (graphics_world *world);
+static void graphics_write_message (render_target *target);
+static void graphics_draw_zone (render_target *target);
+static void graphics_draw_overlay (render_target *target);
+static void graphics_draw_preview (render_target *target);
+static void graphics_stroke_segment (render_target *target, int index);
+static void graphics_stroke_redraw (graphics_world *world);
+static void graphics_target_init (render_target *target, graphics_world *world, cairo_t *cr, int width, int height);
+static cpVect graphics_project (render_target *target, cpVect point);
+static void graphics_batch_shape (cpShape *shape, render_target *target);
+static void graphics_hud_reset (graphics_hud *hud);
+static void graphics_hud_roll (graphics_hud *hud, double now);
+static void graphics_draw_hud (render_target *target);
 
 /*
-	iterates over the bodies of the cpSpace inside the world
-	and calls graphics_draw_body on each body	
+	draws the world into the window of the GTK
+	drawing screen, through the context of its draw
+	signal, which GTK clips to the area to redraw
 
 	Parameters:
-		*world = graphics world 
+		*world = graphics world, with cr set by the
+			draw callback
 
 	Returns: nothing
  */
 void 
 graphics_space_iterate (graphics_world *world) {
 
+	int window_height = gtk_widget_get_allocated_height(world -> drawing_screen);
+	int window_width = gtk_widget_get_allocated_width(world -> drawing_screen);
+
+	cairo_t *cr = world->cr;
+
+	if (world->hud.visible) {
+
+		double start = graphics_hud_now ();
+
+		graphics_render (world, cr, window_width, window_height);
+
+		world->hud.frames++;
+		world->hud.render_time += graphics_hud_now () - start;
+	}
+	else {
+		graphics_render (world, cr, window_width, window_height);
+	}
+}
+
+/*
+	iterates over the bodies of the cpSpace inside the world,
+	batches them by color and draws each color at once.
+	Does not depend on GTK, so cr can be any cairo context.
+
+	Parameters:
+		*world = graphics world 
+		*cr = cairo context to draw into
+		width = width of the context in pixels
+		height = height of the context in pixels
+
+	Returns: nothing
+ */
+void
+graphics_render (graphics_world *world, cairo_t *cr, int width, int height) {
+
+	render_target target;
+	graphics_target_init (&target, world, cr, width, height);
+
+	cairo_save (cr);
+
 	//draw the drawing zone
 	if (world->display)
-		graphics_draw_zone (world);
+		graphics_draw_zone (&target);
+
+	//faint path the stroke would take if it were dropped now
+	if (world->preview->len > 1)
+		graphics_draw_preview (&target);
 
 	//draw the outline of the user's object
-	if (world->user_points->len > 0)
-		graphics_partial_shape (world);
+	if (world->overlay != NULL && world->overlay_points > 1)
+		graphics_draw_overlay (&target);
 
-	//chipmunk iterator for each body
-	cpSpaceEachBody(world->space, (cpSpaceBodyIteratorFunc) graphics_draw_body, world);
-	
-	//draw the ground
-	graphics_draw_body (world->space->staticBody, world);
-	
+	//the part of the world inside the clip, with room for the line width; a
+	//partial redraw only batches the bodies under the area it redraws
+	double x1, y1, x2, y2;
+	cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+
+	cpBB viewport = cpBBNew (target.center.x + (x1 - width / 2.0 - 6) / target.screen_width_ratio,
+							 target.center.y - (y2 - height / 2.0 + 6) / target.screen_height_ratio,
+							 target.center.x + (x2 - width / 2.0 + 6) / target.screen_width_ratio,
+							 target.center.y - (y1 - height / 2.0 - 6) / target.screen_height_ratio);
+
+	if (batched_bodies == NULL)
+		batched_bodies = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	//sort the visible bodies, ground included, into one batch per color
+	cpSpaceBBQuery (world->space, viewport, CP_ALL_LAYERS, CP_NO_GROUP,
+					(cpSpaceBBQueryFunc) graphics_batch_shape, &target);
+
+	g_hash_table_remove_all (batched_bodies);
+
+	//one fill and one stroke per color
+	graphics_draw_batches (&target);
 	
-	graphics_write_message (world);
+	graphics_write_message (&target);
+
+	if (world->hud.visible)
+		graphics_draw_hud (&target);
+
+	cairo_restore (cr);
 }
 
 /*
-	draws the line tracing the user's drawing in
-	the currently set color
+	allocates an empty graphics world
+
+	Parameters: none
+
+	Returns: pointer to the new graphics world
+ */
+graphics_world *
+graphics_world_new (void) {
+
+	graphics_world *world = (graphics_world *) malloc(sizeof(graphics_world));
+
+	//null checking
+	if (world == NULL) {
+
+		printf("Memory allocation error: in graphics_world_new\n");
+		exit(-1);
+	}
+
+	world->space = NULL;
+	world->display = false;
+	world->x1 = world->y1 = world->x2 = world->y2 = 0;
+	world->window = NULL;
+	world->drawing_screen = NULL;
+	world->cr = NULL;
+	world->message = NULL;
+	world->user_points = g_array_new (FALSE, FALSE, sizeof(cpVect));
+	world->color = RED;
+	world->image = NULL;
+	world->overlay = NULL;
+	world->overlay_points = 0;
+	world->overlay_length = 0;
+	world->preview = g_array_new (FALSE, FALSE, sizeof(cpVect));
+	world->preview_hit = false;
+	world->previous_pos = NULL;
+	world->previous_angle = NULL;
+	world->previous_count = 0;
+	world->interpolation = 1;
+
+	graphics_camera_reset (world);
+
+	world->hud.visible = false;
+	graphics_hud_reset (&world->hud);
+
+	return world;
+}
+
+/*
+	frees a graphics world and everything it owns; the
+	space, the widgets and the previous poses belong to
+	the caller
+
+	Parameters:
+		*world = graphics world to free
+
+	Returns: nothing
+ */
+void
+graphics_world_free (graphics_world *world) {
+
+	g_array_free (world->user_points, TRUE);
+	g_array_free (world->preview, TRUE);
+
+	if (world->overlay != NULL)
+		cairo_surface_destroy (world->overlay);
+
+	free (world->message);
+	free (world);
+}
+
+/*
+	returns the current time of the monotonic clock
+
+	Parameters: none
+
+	Returns: time in seconds
+ */
+double
+graphics_hud_now (void) {
+
+	return (double) g_get_monotonic_time () / G_USEC_PER_SEC;
+}
+
+/*
+	shows or hides the performance overlay and starts
+	its statistics from scratch
 
 	Parameters:
 		*world = graphics world 
 
+	Returns: nothing
+ */
+void
+graphics_hud_toggle (graphics_world *world) {
+
+	world->hud.visible = !world->hud.visible;
+	graphics_hud_reset (&world->hud);
+}
+
+/*
+	clears the counters and displayed values and starts
+	a new window
+
+	Parameters:
+		*hud = statistics to reset
+
 	Returns: nothing
  */
 static void
-graphics_partial_shape (graphics_world *world) {
+graphics_hud_reset (graphics_hud *hud) {
 
-	int space_height = 50, space_width = 50;
-    int window_height = gtk_widget_get_allocated_height(world -> drawing_screen);
-    int window_width = gtk_widget_get_allocated_width(world -> drawing_screen);
+	hud->window_start = graphics_hud_now ();
+
+	hud->frames = hud->snapshots = 0;
+	hud->render_time = hud->decode_time = hud->apply_time = 0;
+	hud->bytes = 0;
+
+	hud->fps = hud->frame_ms = hud->snapshot_rate = 0;
+	hud->decode_ms = hud->apply_ms = hud->bytes_rate = 0;
+	hud->rtt_ms = -1;
+}
+
+/*
+	records a message received from the server
+
+	Parameters:
+		*world = graphics world 
+		bytes = size of the message
+
+	Returns: nothing
+ */
+void
+graphics_hud_received (graphics_world *world, int bytes) {
+
+	if (world->hud.visible)
+		world->hud.bytes += bytes;
+}
+
+/*
+	records one position snapshot
+
+	Parameters:
+		*world = graphics world 
+		decode_time = seconds spent in protocol_extract_coords
+		apply_time = seconds spent applying the poses
+
+	Returns: nothing
+ */
+void
+graphics_hud_snapshot (graphics_world *world, double decode_time, double apply_time) {
+
+	if (!world->hud.visible)
+		return;
+
+	world->hud.snapshots++;
+	world->hud.decode_time += decode_time;
+	world->hud.apply_time += apply_time;
+}
+
+/*
+	records the round trip time of a ping
+
+	Parameters:
+		*world = graphics world 
+		rtt = round trip time in seconds
+
+	Returns: nothing
+ */
+void
+graphics_hud_rtt (graphics_world *world, double rtt) {
+
+	if (world->hud.visible)
+		world->hud.rtt_ms = 1000 * rtt;
+}
+
+/*
+	turns the counters into the displayed values once the
+	current window is a second old, and starts a new window
+
+	Parameters:
+		*hud = statistics to roll
+		now = current time in seconds
+
+	Returns: nothing
+ */
+static void
+graphics_hud_roll (graphics_hud *hud, double now) {
+
+	double elapsed = now - hud->window_start;
+
+	if (elapsed < 1)
+		return;
+
+	hud->fps = hud->frames / elapsed;
+	hud->frame_ms = (hud->frames > 0) ? 1000 * hud->render_time / hud->frames : 0;
+	hud->snapshot_rate = hud->snapshots / elapsed;
+	hud->decode_ms = (hud->snapshots > 0) ? 1000 * hud->decode_time / hud->snapshots : 0;
+	hud->apply_ms = (hud->snapshots > 0) ? 1000 * hud->apply_time / hud->snapshots : 0;
+	hud->bytes_rate = hud->bytes / elapsed;
+
+	hud->frames = hud->snapshots = 0;
+	hud->render_time = hud->decode_time = hud->apply_time = 0;
+	hud->bytes = 0;
+	hud->window_start = now;
+}
+
+/*
+	draws the performance overlay in the top left corner
+
+	Parameters:
+		*target = render target to draw into
+
+	Returns: nothing
+ */
+static void
+graphics_draw_hud (render_target *target) {
+
+	graphics_hud *hud = &target->world->hud;
+	cairo_t *cr = target->cr;
+
+	graphics_hud_roll (hud, graphics_hud_now ());
+
+	char lines[7][40];
+
+	sprintf (lines[0], "fps       %6.1f", hud->fps);
+	sprintf (lines[1], "frame     %6.2f ms", hud->frame_ms);
+	sprintf (lines[2], "snapshots %6.1f /s", hud->snapshot_rate);
+	sprintf (lines[3], "decode    %6.3f ms", hud->decode_ms);
+	sprintf (lines[4], "apply     %6.3f ms", hud->apply_ms);
+	sprintf (lines[5], "received  %6.1f kB/s", hud->bytes_rate / 1024);
+
+	if (hud->rtt_ms < 0)
+		sprintf (lines[6], "rtt          n/a");
+	else
+		sprintf (lines[6], "rtt       %6.1f ms", hud->rtt_ms);
+
+	cairo_save (cr);
+
+	cairo_set_source_rgba (cr, 0, 0, 0, 0.6);
+	cairo_rectangle (cr, 4, 4, 170, 7 * 13 + 8);
+	cairo_fill (cr);
+
+	cairo_select_font_face (cr, "monospace", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+	cairo_set_font_size (cr, 11);
+	cairo_set_source_rgb (cr, 1, 1, 1);
+
+	for (int i = 0; i < 7; i++) {
+		cairo_move_to (cr, 10, 18 + 13 * i);
+		cairo_show_text (cr, lines[i]);
+	}
+
+	cairo_restore (cr);
+}
+
+/*
+	fills in a render target for the current camera
+
+	Parameters:
+		*target = render target to fill in
+		*world = graphics world 
+		*cr = cairo context to draw into
+		width = width of the context in pixels
+		height = height of the context in pixels
+
+	Returns: nothing
+ */
+static void
+graphics_target_init (render_target *target, graphics_world *world, cairo_t *cr, int width, int height) {
+
+	target->world = world;
+	target->cr = cr;
+	target->width = width;
+	target->height = height;
+	target->screen_width_ratio = world->camera.zoom * width / GRAPHICS_SPACE_WIDTH;
+	target->screen_height_ratio = world->camera.zoom * height / GRAPHICS_SPACE_HEIGHT;
+	target->center = world->camera.center;
+}
+
+/*
+	converts a point of the world into pixel coordinates
+	of the render target
+
+	Parameters:
+		*target = render target
+		point = point in world coordinates
+
+	Returns: the point in pixel coordinates
+ */
+static cpVect
+graphics_project (render_target *target, cpVect point) {
+
+	return cpv(target->width / 2 + target->screen_width_ratio * (point.x - target->center.x),
+			   target->height / 2 - target->screen_height_ratio * (point.y - target->center.y));
+}
+
+/*
+	converts a pixel of the drawing screen into world
+	coordinates, taking the camera into account
+
+	Parameters:
+		*world = graphics world 
+		x, y = pixel coordinates in the drawing screen
+
+	Returns: the point in world coordinates
+ */
+cpVect
+graphics_screen_to_world (graphics_world *world, double x, double y) {
+
+	int window_height = gtk_widget_get_allocated_height(world -> drawing_screen);
+	int window_width = gtk_widget_get_allocated_width(world -> drawing_screen);
+
+	float screen_height_ratio = world->camera.zoom * window_height / GRAPHICS_SPACE_HEIGHT;
+	float screen_width_ratio = world->camera.zoom * window_width / GRAPHICS_SPACE_WIDTH;
+
+	return cpv(world->camera.center.x + (x - window_width / 2) / screen_width_ratio,
+			   world->camera.center.y + (-y + window_height / 2) / screen_height_ratio);
+}
+
+/*
+	shows the whole default 50x50 world again
+
+	Parameters:
+		*world = graphics world 
+
+	Returns: nothing
+ */
+void
+graphics_camera_reset (graphics_world *world) {
+
+	world->camera.center = cpv(0, 0);
+	world->camera.zoom = 1;
+
+	graphics_stroke_redraw (world);
+}
+
+/*
+	zooms the camera, keeping the world point under the
+	given pixel of the drawing screen in place
+
+	Parameters:
+		*world = graphics world 
+		factor = how much to zoom in (less than 1 zooms out)
+		x, y = pixel coordinates that stay fixed
+
+	Returns: nothing
+ */
+void
+graphics_camera_zoom (graphics_world *world, float factor, double x, double y) {
+
+	cpVect fixed = graphics_screen_to_world (world, x, y);
+
+	float zoom = world->camera.zoom * factor;
+
+	if (zoom < CAMERA_MIN_ZOOM)
+		zoom = CAMERA_MIN_ZOOM;
+	else if (zoom > CAMERA_MAX_ZOOM)
+		zoom = CAMERA_MAX_ZOOM;
+
+	factor = zoom / world->camera.zoom;
+	world->camera.zoom = zoom;
+
+	// move the center towards the fixed point by the same ratio
+	world->camera.center = cpvadd (fixed, cpvmult (cpvsub (world->camera.center, fixed), 1 / factor));
+
+	graphics_stroke_redraw (world);
+}
+
+/*
+	moves the camera by a fraction of the visible area
+
+	Parameters:
+		*world = graphics world 
+		dx, dy = fractions of the visible width and height
+
+	Returns: nothing
+ */
+void
+graphics_camera_pan (graphics_world *world, float dx, float dy) {
+
+	world->camera.center.x += dx * GRAPHICS_SPACE_WIDTH / world->camera.zoom;
+	world->camera.center.y += dy * GRAPHICS_SPACE_HEIGHT / world->camera.zoom;
+
+	graphics_stroke_redraw (world);
+}
+
+/*
+	handles the camera keys: + and - zoom around the
+	middle of the screen, the arrows pan and 0 resets
+
+	Parameters:
+		*world = graphics world 
+		keyval = GDK key value that was pressed
+
+	Returns: true if the key moved the camera
+ */
+bool
+graphics_camera_key (graphics_world *world, guint keyval) {
+
+	int window_height = gtk_widget_get_allocated_height(world -> drawing_screen);
+	int window_width = gtk_widget_get_allocated_width(world -> drawing_screen);
+
+	switch (keyval) {
+
+		case GDK_KEY_plus:
+		case GDK_KEY_equal:
+			graphics_camera_zoom (world, CAMERA_ZOOM_STEP, window_width / 2, window_height / 2);
+			break;
+
+		case GDK_KEY_minus:
+			graphics_camera_zoom (world, 1 / CAMERA_ZOOM_STEP, window_width / 2, window_height / 2);
+			break;
+
+		case GDK_KEY_Left:
+			graphics_camera_pan (world, -CAMERA_PAN_STEP, 0);
+			break;
+
+		case GDK_KEY_Right:
+			graphics_camera_pan (world, CAMERA_PAN_STEP, 0);
+			break;
+
+		case GDK_KEY_Up:
+			graphics_camera_pan (world, 0, CAMERA_PAN_STEP);
+			break;
+
+		case GDK_KEY_Down:
+			graphics_camera_pan (world, 0, -CAMERA_PAN_STEP);
+			break;
+
+		case GDK_KEY_0:
+			graphics_camera_reset (world);
+			break;
+
+		default:
+			return false;
+	}
+
+	gtk_widget_queue_draw (world->drawing_screen);
+
+	return true;
+}
+
+/*
+	paints the stroke overlay on top of the target
+
+	Parameters:
+		*target = render target to draw into
+
+	Returns: nothing
+ */
+static void
+graphics_draw_overlay (render_target *target) {
+
+	cairo_t *cr = target->cr;
+
+	cairo_save (cr);
+
+	cairo_set_source_surface (cr, target->world->overlay, 0, 0);
+	cairo_paint (cr);
+
+	cairo_restore (cr);
+}
+
+/*
+	draws the predicted path of the stroke as a faint
+	line, green with a dot at its end if it reaches the
+	target
+
+	Parameters:
+		*target = render target to draw into
+
+	Returns: nothing
+ */
+static void
+graphics_draw_preview (render_target *target) {
+
+	graphics_world *world = target->world;
+	cpVect *path = (cpVect *)world->preview->data;
+	cairo_t *cr = target->cr;
+
+	cairo_save (cr);
+
+	if (world->preview_hit)
+		cairo_set_source_rgba (cr, 0, 0.6, 0, 0.4);
+	else
+		cairo_set_source_rgba (cr, 0, 0, 0, 0.2);
+
+	cairo_set_line_width (cr, 2);
+
+	cpVect point = graphics_project (target, path[0]);
+	cairo_move_to (cr, point.x, point.y);
+
+	for (guint i = 1; i < world->preview->len; i++) {
+		point = graphics_project (target, path[i]);
+		cairo_line_to (cr, point.x, point.y);
+	}
+
+	cairo_stroke (cr);
+
+	if (world->preview_hit) {
+		cairo_arc (cr, point.x, point.y, 4, 0, 2 * G_PI);
+		cairo_fill (cr);
+	}
+
+	cairo_restore (cr);
+}
+
+/*
+	strokes the segment of the user's drawing that ends
+	at user_points[index] onto the overlay in the
+	currently set color
+
+	Parameters:
+		*target = render target of the overlay
+		index = index of the last point of the segment
+
+	Returns: nothing
+ */
+static void
+graphics_stroke_segment (render_target *target, int index) {
+
+	graphics_world *world = target->world;
+	cairo_t *cr = target->cr;
 
-	float screen_height_ratio = (float)window_height / space_height;
-	float screen_width_ratio = (float)window_width / space_width;
-	
 	static const double dashed[] = {14.0, 6.0};
   	static int len  = sizeof(dashed) / sizeof(dashed[0]);
 
-	cairo_t *cr = gdk_cairo_create (gtk_widget_get_window(world->drawing_screen));
+	cpVect *vect = (cpVect *)world->user_points->data;
+
+	cpVect from = graphics_project (target, vect[index - 1]);
+	cpVect to = graphics_project (target, vect[index]);
 
-	cairo_set_dash(cr, dashed, len, 1);
+	// continue the dashes where the previous segment stopped
+	cairo_set_dash(cr, dashed, len, 1 + world->overlay_length);
 
 	graphics_set_rgb_from_color (&cr, world->color);
 
-	cairo_translate (cr, window_width / 2 , window_height / 2);
+	cairo_move_to (cr, from.x, from.y);
+	cairo_line_to (cr, to.x, to.y);
+	cairo_stroke (cr);
 
-	cpVect *vect = (cpVect *)world->user_points->data;
+	world->overlay_length += cpvdist (from, to);
+}
 
-	cairo_move_to (cr, screen_width_ratio * vect[0].x, -screen_height_ratio * vect[0].y);
+/*
+	throws away what is on the overlay so the next
+	graphics_stroke_append draws the whole stroke again,
+	used when the camera moves in the middle of a stroke
 
-	//connect each user input mouse point with dashes
-	for (int i = 1; i < world->user_points->len; i++) {
-		cairo_line_to (cr, screen_width_ratio * vect[i].x, -screen_height_ratio * vect[i].y);
+	Parameters:
+		*world = graphics world 
+
+	Returns: nothing
+ */
+static void
+graphics_stroke_redraw (graphics_world *world) {
+
+	if (world->overlay == NULL)
+		return;
+
+	cairo_t *cr = cairo_create (world->overlay);
+
+	cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+	cairo_paint (cr);
+
+	cairo_destroy (cr);
+
+	world->overlay_points = (world->user_points->len > 0) ? 1 : 0;
+	world->overlay_length = 0;
+
+	if (world->user_points->len > 1)
+		graphics_stroke_append (world);
+}
+
+/*
+	appends the newest segment of the user's drawing to
+	the overlay and redraws only the area it covers
+
+	Parameters:
+		*world = graphics world 
+
+	Returns: nothing
+ */
+void
+graphics_stroke_append (graphics_world *world) {
+
+	int window_height = gtk_widget_get_allocated_height(world -> drawing_screen);
+	int window_width = gtk_widget_get_allocated_width(world -> drawing_screen);
+
+	// (re)create the overlay if the window was resized,
+	// and redraw the stroke so far onto the new one
+	if (world->overlay == NULL
+		|| cairo_image_surface_get_width (world->overlay) != window_width
+		|| cairo_image_surface_get_height (world->overlay) != window_height) {
+
+		if (world->overlay != NULL)
+			cairo_surface_destroy (world->overlay);
+
+		world->overlay = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, window_width, window_height);
+		world->overlay_points = (world->user_points->len > 0) ? 1 : 0;
+		world->overlay_length = 0;
 	}
-	
-	cairo_stroke(cr);
 
-	cairo_destroy(cr);
+	if (world->user_points->len < 2) {
+		world->overlay_points = world->user_points->len;
+		return;
+	}
+
+	render_target target;
+	graphics_target_init (&target, world, cairo_create (world->overlay), window_width, window_height);
+
+	int first = (world->overlay_points < 1) ? 1 : world->overlay_points;
+
+	for (int i = first; i < world->user_points->len; i++)
+		graphics_stroke_segment (&target, i);
+
+	cairo_destroy (target.cr);
+
+	world->overlay_points = world->user_points->len;
+
+	// invalidate the bounding box of the new segments only
+	cpVect *vect = (cpVect *)world->user_points->data;
+	cpBB box = cpBBNew (vect[first - 1].x, vect[first - 1].y, vect[first - 1].x, vect[first - 1].y);
+
+	for (int i = first; i < world->user_points->len; i++)
+		box = cpBBExpand (box, vect[i]);
+
+	cpVect top_left = graphics_project (&target, cpv(box.l, box.t));
+	cpVect bottom_right = graphics_project (&target, cpv(box.r, box.b));
+
+	int margin = 4;
+	int x = top_left.x - margin;
+	int y = top_left.y - margin;
+	int width = bottom_right.x - top_left.x + 2 * margin;
+	int height = bottom_right.y - top_left.y + 2 * margin;
+
+	gtk_widget_queue_draw_area (world->drawing_screen, x, y, width, height);
 }
 
 /*
-	writes the message to the screen
+	clears the overlay holding the user's drawing
 
 	Parameters:
 		*world = graphics world 
 
+	Returns: nothing
+ */
+void
+graphics_stroke_clear (graphics_world *world) {
+
+	world->overlay_points = 0;
+	world->overlay_length = 0;
+
+	if (world->overlay == NULL)
+		return;
+
+	cairo_t *cr = cairo_create (world->overlay);
+
+	cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+	cairo_paint (cr);
+
+	cairo_destroy (cr);
+
+	gtk_widget_queue_draw (world->drawing_screen);
+}
+
+/*
+	writes the message to the screen
+
+	Parameters:
+		*target = render target to draw into
+
 	Returns: nothing
  */
 static void
-graphics_write_message (graphics_world *world) {
+graphics_write_message (render_target *target) {
 
-	int window_height = gtk_widget_get_allocated_height(world -> drawing_screen);
-    int window_width = gtk_widget_get_allocated_width(world -> drawing_screen);
+	graphics_world *world = target->world;
+	int window_height = target->height;
+	int window_width = target->width;
 	cairo_text_extents_t extents;
 
-	cairo_t *cr = gdk_cairo_create (gtk_widget_get_window(world->drawing_screen));
+	cairo_t *cr = target->cr;
+
+	cairo_save (cr);
 
 	cairo_set_source_rgb (cr, 1, 0, 0);
 
@@ -149,7 +911,7 @@ graphics_write_message (graphics_world *world) {
 		cairo_show_text (cr, world->message);
 	}
 
-	cairo_destroy (cr);
+	cairo_restore (cr);
 }
 
 /*
@@ -157,25 +919,23 @@ graphics_write_message (graphics_world *world) {
 	the player is allowed to draw
 
 	Parameters:
-		*world = graphics world 
+		*target = render target to draw into
 
 	Returns: nothing
  */
 static void
-graphics_draw_zone (graphics_world *world) {
+graphics_draw_zone (render_target *target) {
 	
-	int space_height = 50, space_width = 50;
-    int window_height = gtk_widget_get_allocated_height(world -> drawing_screen);
-    int window_width = gtk_widget_get_allocated_width(world -> drawing_screen);
+	graphics_world *world = target->world;
 
-	float screen_height_ratio = (float)window_height / space_height;
-	float screen_width_ratio = (float)window_width / space_width;
+	cpVect bottom_left = graphics_project (target, cpv(world->x1, world->y1));
+	cpVect top_right = graphics_project (target, cpv(world->x2, world->y2));
 
-	cairo_t *cr = gdk_cairo_create (gtk_widget_get_window(world->drawing_screen));
+	cairo_t *cr = target->cr;
+
+	cairo_save (cr);
 
 	cairo_set_source_rgba(cr, 0, 0, 0, 1);
-	
-	cairo_translate (cr, window_width / 2 , window_height / 2);
 
 	//Dash influenced from zetcode.com
 	static const double dashed[] = {14.0, 6.0};
@@ -183,96 +943,244 @@ graphics_draw_zone (graphics_world *world) {
 
 	cairo_set_dash(cr, dashed, len, 1);
 
-  	cairo_move_to(cr, screen_width_ratio * world->x1, -screen_height_ratio * world->y1);  
-  	cairo_line_to(cr, screen_width_ratio * world->x1, -screen_height_ratio * world->y2);
-	cairo_line_to(cr, screen_width_ratio * world->x2, -screen_height_ratio * world->y2);
-	cairo_line_to(cr, screen_width_ratio * world->x2, -screen_height_ratio * world->y1);
-	cairo_line_to(cr, screen_width_ratio * world->x1, -screen_height_ratio * world->y1);
+  	cairo_move_to(cr, bottom_left.x, bottom_left.y);  
+  	cairo_line_to(cr, bottom_left.x, top_right.y);
+	cairo_line_to(cr, top_right.x, top_right.y);
+	cairo_line_to(cr, top_right.x, bottom_left.y);
+	cairo_line_to(cr, bottom_left.x, bottom_left.y);
   	cairo_stroke(cr);
 
-	cairo_destroy(cr);
+	cairo_restore(cr);
 
 }
 
 /*
-	draws the body to the screen
+	transforms the outline of the body into screen
+	coordinates and appends it to the batch of its color
 
 	Parameters:
 		*body = body to be drawn
-		*world = graphics world 
+		*target = render target the batches are drawn into
 
 	Returns: nothing
  */
 static void
-graphics_draw_body ( cpBody *body, graphics_world *world ) {
+graphics_batch_body ( cpBody *body, render_target *target ) {
+
+	if (body_coords.positions == NULL) {
+
+		body_coords.capacity = 1;
+		body_coords.positions = (cpVect *) malloc(body_coords.capacity * sizeof(cpVect));
+
+		//null checking
+		if (body_coords.positions == NULL) {
+
+			printf("Memory allocation error: in graphics_batch_body\n");
+			exit(-1);
+		}
+	}
+
+	body_information *info = cpBodyGetUserData (body);
+	cpVect *outline;
+	int outline_size;
 
-	cpVect point_position = cpBodyGetPos (body);
+	if (info != NULL && info->outline != NULL) {
+		outline = info->outline;
+		outline_size = info->outline_count;
+	}
+	else {
+		body_coords.size = 0;
+
+		//iterate over each segment for new coordinates
+		cpBodyEachShape(body, (cpBodyShapeIteratorFunc) graphics_get_shape, &body_coords);
+
+		outline = body_coords.positions;
+		outline_size = body_coords.size;
+	}
+
+	if (outline_size == 0)
+		return;
+
+	polygon_batch *batch = &batches[(info == NULL) ? BATCH_NO_COLOR : info->color];
+
+	cpVect position = cpBodyGetPos (body);
 	cpFloat angle = cpBodyGetAngle (body);
 
-	drawing_coordinates *coords = (drawing_coordinates *) malloc(sizeof(drawing_coordinates));
+	// in between the last two steps when the frame falls between them
+	graphics_world *world = target->world;
+	if (info != NULL && info->body_id < world->previous_count && !cpBodyIsStatic (body)) {
 
-	//null checking
-	if (coords == NULL) {
+		cpFloat t = world->interpolation;
+		position = cpvlerp (world->previous_pos[info->body_id], position, t);
+		angle = world->previous_angle[info->body_id] + (angle - world->previous_angle[info->body_id]) * t;
+	}
 
-		printf("Memory allocation error: in graphics_draw_body\n");
-		exit(-1);
+	cpVect rotation = cpvforangle (angle);
+
+	// signed area of the outline, so every polygon of a batch can be
+	// appended with the same winding and overlapping bodies do not
+	// punch holes into each other when the batch is filled
+	cpFloat area = 0;
+	for (int i = 0; i < outline_size; i++) {
+		cpVect a = outline[i];
+		cpVect b = outline[(i + 1) % outline_size];
+		area += cpvcross (a, b);
 	}
-	coords->capacity = 1;
-	coords->size = 0;
-	coords->positions = (cpVect *) malloc(coords->capacity * sizeof(cpVect));
 
-	//null checking
-	if (coords->positions == NULL) {
+	for (int i = 0; i < outline_size; i++) {
 
-		printf("Memory allocation error: in graphics_draw_body\n");
-		exit(-1);
+		int index = (area < 0) ? outline_size - 1 - i : i;
+		cpVect point = cpvadd (position, cpvrotate (outline[index], rotation));
+
+		graphics_batch_append (batch, graphics_project (target, point));
 	}
 
-	//iterate over each shape for new coordinates
-	cpBodyEachShape(body, (cpBodyShapeIteratorFunc) graphics_get_shape, coords);
+	if (batch->polygon_count >= batch->polygon_capacity) {
 
-	if (coords->size > 0) {
+		batch->polygon_capacity = (batch->polygon_capacity == 0) ? 8 : batch->polygon_capacity * 2;
+		batch->polygon_sizes = (int *) realloc(batch->polygon_sizes, batch->polygon_capacity * sizeof(int));
 
-		int space_height = 50, space_width = 50;
-    	int window_height = gtk_widget_get_allocated_height(world -> drawing_screen);
-    	int window_width = gtk_widget_get_allocated_width(world -> drawing_screen);
+		//null checking
+		if (batch->polygon_sizes == NULL) {
 
-		float screen_height_ratio = (float)window_height / space_height;
-		float screen_width_ratio = (float)window_width / space_width;
+			printf("Memory allocation error: in graphics_batch_body\n");
+			exit(-1);
+		}
+	}
 
-		cairo_t *cr = gdk_cairo_create (gtk_widget_get_window(world->drawing_screen));
+	batch->polygon_sizes[batch->polygon_count++] = outline_size;
+}
 
-		graphics_set_color_from_body (&cr, body);
+/*
+	handles the scroll wheel: zooms in or out around the
+	pixel under the mouse
+
+	Parameters:
+		*world = graphics world 
+		direction = direction of the scroll event
+		x, y = pixel under the mouse
 
-		cairo_matrix_t saved_transform;
-		cairo_get_matrix(cr, &saved_transform);
+	Returns: true if the scroll moved the camera
+ */
+bool
+graphics_camera_scroll (graphics_world *world, GdkScrollDirection direction, double x, double y) {
 
-		cairo_set_line_width (cr, 6);
+	if (direction == GDK_SCROLL_UP)
+		graphics_camera_zoom (world, CAMERA_ZOOM_STEP, x, y);
+	else if (direction == GDK_SCROLL_DOWN)
+		graphics_camera_zoom (world, 1 / CAMERA_ZOOM_STEP, x, y);
+	else
+		return false;
 
-		cairo_translate (cr, window_width / 2 + screen_width_ratio * point_position.x, window_height - window_height / 2 - screen_height_ratio * point_position.y);
+	gtk_widget_queue_draw (world->drawing_screen);
 
-		cairo_rotate(cr, -angle);
+	return true;
+}
 
-		cairo_move_to (cr, screen_width_ratio * coords->positions[0].x, -screen_height_ratio * coords->positions[0].y);
+/*
+	viewport query callback; batches the body of the
+	shape unless it has been batched this frame already
 
-		// creates the outline of the shape
-		for (int i = 1; i < coords->size; i++) {
-		
-			cairo_line_to (cr, screen_width_ratio * coords->positions[i].x, -screen_height_ratio * coords->positions[i].y);
+	Parameters:
+		*shape = visible shape
+		*target = render target the batches are drawn into
 
-			cairo_stroke_preserve (cr);
+	Returns: nothing
+ */
+static void
+graphics_batch_shape (cpShape *shape, render_target *target) {
+
+	cpBody *body = cpShapeGetBody (shape);
+
+	if (g_hash_table_contains (batched_bodies, body))
+		return;
+
+	g_hash_table_add (batched_bodies, body);
+	graphics_batch_body (body, target);
+}
+
+/*
+	appends one screen space point to a batch
+
+	Parameters:
+		*batch = batch to append to
+		point = the point, already in screen coordinates
+
+	Returns: nothing
+ */
+static void
+graphics_batch_append (polygon_batch *batch, cpVect point) {
+
+	if (batch->size >= batch->capacity) {
+
+		batch->capacity = (batch->capacity == 0) ? 64 : batch->capacity * 2;
+		batch->points = (cpVect *) realloc(batch->points, batch->capacity * sizeof(cpVect));
+
+		//null checking
+		if (batch->points == NULL) {
+
+			printf("Memory allocation error: in graphics_batch_append\n");
+			exit(-1);
 		}
-		
-		// close and fill
-		cairo_close_path(cr);
-		cairo_fill (cr);
-		
-		cairo_destroy(cr);
+	}
+
+	batch->points[batch->size++] = point;
+}
+
+/*
+	draws every batch with one fill and one stroke per
+	color, then empties the batches for the next frame
+
+	Parameters:
+		*target = render target to draw into
+
+	Returns: nothing
+ */
+static void
+graphics_draw_batches (render_target *target) {
+
+	cairo_t *cr = target->cr;
 
+	cairo_save (cr);
+
+	cairo_set_line_width (cr, 6);
+
+	for (int color = 0; color < BATCH_COUNT; color++) {
+
+		polygon_batch *batch = &batches[color];
+
+		if (batch->polygon_count == 0)
+			continue;
+
+		if (color == BATCH_NO_COLOR)
+			cairo_set_source_rgb (cr, 0, 0, 0);
+		else
+			graphics_set_rgb_from_color (&cr, color);
+
+		cairo_new_path (cr);
+
+		cpVect *point = batch->points;
+
+		// one closed sub path per body
+		for (int i = 0; i < batch->polygon_count; i++) {
+
+			cairo_move_to (cr, point[0].x, point[0].y);
+
+			for (int j = 1; j < batch->polygon_sizes[i]; j++)
+				cairo_line_to (cr, point[j].x, point[j].y);
+
+			cairo_close_path (cr);
+			point += batch->polygon_sizes[i];
+		}
+
+		cairo_fill_preserve (cr);
+		cairo_stroke (cr);
+
+		batch->size = 0;
+		batch->polygon_count = 0;
 	}
 
-	free (coords->positions);
-	free (coords);
+	cairo_restore (cr);
 }
 
 /*
@@ -298,28 +1206,6 @@ graphics_get_shape (cpBody *body, cpShape *shape, drawing_coordinates *coords) {
 	coords->positions[coords->size - 1] = cpSegmentShapeGetA (shape);
 }
 
-/*
-	Sets the color according of the cairo pointer according to the shape color
-
-	Parameters:
-    	**cr = cairo pointer that is used to draw to drawing area
-    	shape = shape that must be drawn on screen
-
-	Returns: nothing
- */
-static void
-graphics_set_color_from_body (cairo_t **cr, cpBody *body) {
-
-	body_information *info = cpBodyGetUserData(body);	
-
-	if ((info == NULL) || (&(info->color) == NULL)) {
-		cairo_set_source_rgb (*cr, 0, 0, 0);
-	}
-	else {
-		graphics_set_rgb_from_color (cr, info->color);
-	}
-}
-
 /*
 	sets the rgb of the shapes based off the color
 	type passed to it. 
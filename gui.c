@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <string.h>
+#include <math.h>
 #include "specs/common.h"
 #include "specs/graphics.h"
 #include "specs/physics.h"
@@ -11,6 +12,58 @@
 #define DESIRED_NUMBER_VERTICES 10
 #define TEXT_BOX_BUFFER_LIMIT 141
 
+// milliseconds between two frames; the world is stepped by the clock, not
+// by the number of frames
+#define FRAME_INTERVAL 16
+
+// most steps one frame takes to catch up with the clock; time lost to a
+// longer hiccup is dropped instead of making every later frame slower
+#define MAX_CATCH_UP_STEPS 5
+
+// microseconds of each frame that fast forward may spend stepping
+#define FAST_FORWARD_BUDGET 12000
+
+// simulated seconds a headless round may go on after its last drop
+#define HEADLESS_SECONDS 60
+
+// points a stroke needs to be dropped, and so before it is previewed
+#define MIN_STROKE_POINTS 50
+
+#define PREVIEW_SECONDS 3 // how far ahead the preview simulates a stroke
+#define PREVIEW_SAMPLE 3 // steps between two points of the predicted path
+
+/*
+  gui_preview struct
+  state shared between the GTK thread and the worker that
+  predicts where the stroke being drawn would go.  The GTK
+  thread fills in a request, a snapshot of the world and the
+  stroke, every time the stroke changes; the worker restores
+  the snapshot into a world of its own, drops the stroke in
+  and steps it faster than real time.  generation goes up
+  with every request or cancel, and a run whose generation is
+  no longer current stops and is thrown away.  Everything
+  but generation is guarded by lock.
+ */
+typedef struct {
+	GThread *thread;
+	GMutex lock;
+	GCond wake;
+	gint generation;
+	bool pending; // a request the worker has not taken yet
+	bool quit;
+	char *snapshot;
+	size_t snapshot_size;
+	size_t snapshot_capacity;
+	int level;
+	float timestep;
+	GArray *stroke;
+	COLOR color;
+	cpFloat mass;
+	GArray *path; // result of the last run that finished
+	bool hit;
+	gint path_generation;
+} gui_preview;
+
 /*
   gui_world struct
   contains the data needed to represent
@@ -35,6 +88,13 @@ typedef struct {
 	GtkTextBuffer *textbox_buffer;
 	GtkWidget *label;
 	bool delete_text;
+	bool fast_forward; // stepping as fast as the frame allows until the round settles
+	gint64 last_frame; // monotonic time of the last frame, in microseconds
+	double accumulator; // simulated seconds the world is behind the clock
+	cpVect *previous_pos; // poses before the last step by body id, for interpolation
+	cpFloat *previous_angle;
+	int previous_capacity;
+	gui_preview preview;
 } gui_world;
 
 /*
@@ -48,17 +108,35 @@ static void initialize_array (gui_world *world);
 static gboolean cb_button_press (GtkWidget *widget, GdkEventButton *event, gpointer data);
 static void add_user_point (float x, float y, gui_world *world);
 static void delete_text (gui_world *world);
+static void save_poses (gui_world *world);
+static void step_world (gui_world *world);
+static int stroke_decimate (cpVect *points, int count);
+static void preview_start (gui_world *world);
+static void preview_stop (gui_world *world);
+static void preview_request (gui_world *world);
+static void preview_cancel (gui_world *world);
+static gpointer preview_worker (gpointer data);
+static gboolean preview_show (gpointer data);
+static int headless_main (int argc, char *argv[]);
+static bool headless_read_drop (FILE *file, long *tick, COLOR *color, cpFloat *mass, GArray *points);
 
 static gboolean
 new_game (gui_world *world) {
 
 	cpFloat time_step = 1.0/60.0;
 
-	world_free (world->physics);
-
 	world->mass = 1;
-	
-    world->physics = world_new(world->level, time_step);
+	world->fast_forward = false;
+	preview_cancel (world);
+
+	// a retry keeps the world and only puts the level back
+	if (world->physics->level == world->level) {
+		world_reset (world->physics);
+	}
+	else {
+		world_free (world->physics);
+		world->physics = world_new(world->level, time_step);
+	}
 	
     world->graphics -> space = world->physics -> space;
 
@@ -74,6 +152,8 @@ new_game (gui_world *world) {
 	}
 
     world->try_number = 1;
+	world->accumulator = 0;
+	save_poses (world);
 
 	return false;
 }
@@ -131,10 +211,68 @@ draw_cb (GtkWidget *widget, cairo_t *cr, gpointer data) {
 }
 
 
+/*
+  save_poses
+
+  keeps the pose of every body before a step, so that frames
+  between two steps can be drawn in between the two poses
+
+  parameters: gui_world pointer
+ */
+static void
+save_poses (gui_world *world) {
+
+	body_registry *bodies = &world->physics->bodies;
+
+	if (bodies->count > world->previous_capacity) {
+
+		world->previous_capacity = bodies->count * 2;
+		world->previous_pos = (cpVect *)realloc(world->previous_pos, world->previous_capacity * sizeof(cpVect));
+		world->previous_angle = (cpFloat *)realloc(world->previous_angle, world->previous_capacity * sizeof(cpFloat));
+
+		if (world->previous_pos == NULL || world->previous_angle == NULL) {
+			printf("Memory allocation error: in function save_poses\n");
+			exit(-1);
+		}
+	}
+
+	for (int id = 0; id < bodies->count; id++) {
+
+		cpBody *body = bodies->body[id];
+
+		if (body != NULL) {
+			world->previous_pos[id] = cpBodyGetPos (body);
+			world->previous_angle[id] = cpBodyGetAngle (body);
+		}
+	}
+
+	world->graphics->previous_pos = world->previous_pos;
+	world->graphics->previous_angle = world->previous_angle;
+	world->graphics->previous_count = bodies->count;
+	world->graphics->interpolation = 1;
+}
+
+/*
+  step_world
+
+  steps the world once, keeping the poses before the step
+
+  parameters: gui_world pointer
+ */
+static void
+step_world (gui_world *world) {
+
+	save_poses (world);
+	world_update (world->physics);
+}
+
 /*
   time_handler
 
-  basic timestep, updates and draws the world
+  called every FRAME_INTERVAL ms; steps the world by as many
+  fixed timesteps as the monotonic clock has moved on since
+  the last frame, up to MAX_CATCH_UP_STEPS, and draws it
+  interpolated by what is left over
 
   parameters: gui_world pointer
  */
@@ -143,10 +281,53 @@ time_handler(gpointer data) {
 
     gui_world *world = (gui_world *) data;
 
+	gint64 now = g_get_monotonic_time ();
+	double elapsed = (double)(now - world->last_frame) / G_USEC_PER_SEC;
+	world->last_frame = now;
+
 	if (!world->stop) {
-    	world_update(world -> physics);
 
-    	gtk_widget_queue_draw(world -> graphics -> window);
+		float timestep = world->physics->timestep;
+		int steps = 0;
+
+		world->accumulator += elapsed;
+
+		// a settled world is not stepped, so no steps are counted for it
+		while (world->accumulator >= timestep && steps < MAX_CATCH_UP_STEPS
+			   && world->physics->status != 1 && !world->physics->settled) {
+			step_world (world);
+			world->accumulator -= timestep;
+			steps++;
+		}
+
+		if (world->accumulator >= timestep)
+			world->accumulator = fmod (world->accumulator, timestep);
+
+		// as many more steps as fit in the frame, until the round is over
+		if (world->fast_forward) {
+
+			gint64 deadline = g_get_monotonic_time () + FAST_FORWARD_BUDGET;
+
+			while (!world->physics->settled && world->physics->status != 1
+				   && g_get_monotonic_time () < deadline) {
+				step_world (world);
+				steps++;
+			}
+
+			if (world->physics->settled)
+				world->fast_forward = false;
+		}
+
+		// at rest the bodies are drawn where they are, and the time a
+		// settled world waits is not owed to it once a body is dropped
+		if (world->physics->settled)
+			world->accumulator = 0;
+
+		world->graphics->interpolation = world->physics->settled ? 1 : world->accumulator / timestep;
+
+		// a settled world only changes when the player draws
+		if (steps > 0 || !world->physics->settled)
+    		gtk_widget_queue_draw(world -> graphics -> window);
 
 		if (world->delete_text) {
 			delete_text(world);
@@ -253,17 +434,12 @@ cb_button_press (GtkWidget *widget, GdkEventButton *event, gpointer data) {
 
 	world->draw_success = true;
 
-	int space_height = 50, space_width = 50;
-
-    /* convert into cp values */
-    int window_height = gtk_widget_get_allocated_height(world -> graphics -> drawing_screen);
-    int window_width = gtk_widget_get_allocated_width(world -> graphics -> drawing_screen);
-
-    float screen_height_ratio = (float) window_height / space_height;
-    float screen_width_ratio = (float) window_width / space_width;
+	/* convert into cp values */
+	cpVect point = graphics_screen_to_world (world -> graphics, event->x, event->y);
+	cpFloat x = point.x;
+	cpFloat y = point.y;
 
-	cpFloat x = (event->x - window_width / 2) / screen_width_ratio;
-    cpFloat y = (-event->y + window_height / 2) / screen_height_ratio;
+	gtk_widget_grab_focus (widget);
 
 	if (event->button == 1) 
 		add_user_point (x, y, world);
@@ -274,6 +450,7 @@ cb_button_press (GtkWidget *widget, GdkEventButton *event, gpointer data) {
 static void 
 initialize_array (gui_world *world) {
 	world->graphics->user_points = g_array_new (FALSE, FALSE, sizeof(cpVect));
+	graphics_stroke_clear (world->graphics);
 }
 
 static void
@@ -285,6 +462,12 @@ add_user_point (float x, float y, gui_world *world) {
 	}
 	
 	world->graphics->user_points = g_array_append_vals(world->graphics->user_points, &point, 1);
+	graphics_stroke_append (world->graphics);
+
+	if (!world->draw_success)
+		preview_cancel (world);
+	else if (world->graphics->user_points->len >= MIN_STROKE_POINTS)
+		preview_request (world);
 }
 
 static gboolean
@@ -292,7 +475,10 @@ cb_button_release (GtkWidget *widget, GdkEventMotion *event, gpointer data) {
 	
 	gui_world *world = (gui_world *)data;
 
-	if (world->graphics->user_points->len < 50) {
+	// the stroke is finished one way or another
+	preview_cancel (world);
+
+	if (world->graphics->user_points->len < MIN_STROKE_POINTS) {
 		world->graphics->message = (char *)malloc(20 * sizeof(char));
 		strcpy(world->graphics->message, "Size Too Small");
 
@@ -333,24 +519,15 @@ cb_button_release (GtkWidget *widget, GdkEventMotion *event, gpointer data) {
     }
 
 	(world -> try_number)++;
-	
-	int skip_interval = world->graphics->user_points->len / DESIRED_NUMBER_VERTICES;
-
-	int counter = 0;
 
-	for (int i = 0; i < world->graphics->user_points->len; i++) {
-
-		counter++;
-
-		if (counter % skip_interval != 0) {
-
-			g_array_remove_index (world->graphics->user_points, i);
-			i--;
-		}
-	}
+	g_array_set_size (world->graphics->user_points,
+		stroke_decimate ((cpVect *)world->graphics->user_points->data, world->graphics->user_points->len));
 
 	create_user_object ((cpVect *)world->graphics->user_points->data, world->graphics->user_points->len, world->color, world->physics, PLAYER_BOX_COLLISION_NUMBER, 0.7, world->mass); 
 
+	// the new body has no earlier pose to come from
+	save_poses (world);
+
 	g_array_free (world->graphics->user_points, TRUE);
 
 	initialize_array(world);
@@ -368,17 +545,10 @@ motion_notify_event_cb (GtkWidget *widget, GdkEventMotion *event, gpointer data)
 
 	gdk_window_get_pointer (event->window, &x, &y, &state);
 
-	int space_height = 50, space_width = 50;
-
-    /* convert into cp values */
-    int window_height = gtk_widget_get_allocated_height(world -> graphics -> drawing_screen);
-    int window_width = gtk_widget_get_allocated_width(world -> graphics -> drawing_screen);
-
-    float screen_height_ratio = (float) window_height / space_height;
-    float screen_width_ratio = (float) window_width / space_width;
-
-	cpFloat x1 = (x - window_width / 2) / screen_width_ratio;
-    cpFloat y1 = (-y + window_height / 2) / screen_height_ratio;
+	/* convert into cp values */
+	cpVect point = graphics_screen_to_world (world -> graphics, x, y);
+	cpFloat x1 = point.x;
+	cpFloat y1 = point.y;
 
 
 	if (state & GDK_BUTTON1_MASK) {
@@ -389,17 +559,524 @@ motion_notify_event_cb (GtkWidget *widget, GdkEventMotion *event, gpointer data)
 
 }
 
+/*
+  stroke_decimate
+
+  keeps about DESIRED_NUMBER_VERTICES evenly spaced points of
+  a stroke, moving them to the front of the array
+
+  parameters: the points and their number
+
+  returns: the number of points kept
+ */
+static int
+stroke_decimate (cpVect *points, int count) {
+
+	int skip_interval = count / DESIRED_NUMBER_VERTICES;
+	if (skip_interval < 1)
+		skip_interval = 1;
+
+	int kept = 0;
+
+	for (int i = skip_interval - 1; i < count; i += skip_interval)
+		points[kept++] = points[i];
+
+	return kept;
+}
+
+/*
+  preview_start
+
+  sets up the preview and starts its worker thread
+
+  parameters: gui_world pointer
+ */
+static void
+preview_start (gui_world *world) {
+
+	gui_preview *preview = &world->preview;
+
+	g_mutex_init (&preview->lock);
+	g_cond_init (&preview->wake);
+	preview->generation = 0;
+	preview->pending = false;
+	preview->quit = false;
+	preview->snapshot = NULL;
+	preview->snapshot_size = 0;
+	preview->snapshot_capacity = 0;
+	preview->stroke = g_array_new (FALSE, FALSE, sizeof(cpVect));
+	preview->path = g_array_new (FALSE, FALSE, sizeof(cpVect));
+	preview->hit = false;
+	preview->path_generation = -1;
+
+	preview->thread = g_thread_new ("preview", preview_worker, world);
+}
+
+/*
+  preview_stop
+
+  stops the worker thread and frees the preview
+
+  parameters: gui_world pointer
+ */
+static void
+preview_stop (gui_world *world) {
+
+	gui_preview *preview = &world->preview;
+
+	g_mutex_lock (&preview->lock);
+	preview->quit = true;
+	g_atomic_int_inc (&preview->generation);
+	g_cond_signal (&preview->wake);
+	g_mutex_unlock (&preview->lock);
+
+	g_thread_join (preview->thread);
+
+	g_array_free (preview->stroke, TRUE);
+	g_array_free (preview->path, TRUE);
+	free (preview->snapshot);
+	g_mutex_clear (&preview->lock);
+	g_cond_clear (&preview->wake);
+}
+
+/*
+  preview_request
+
+  asks the worker to predict the current stroke from the
+  current state of the world, cancelling the run of the
+  previous stroke.  Only copies, so drawing is not held up.
+
+  parameters: gui_world pointer
+ */
+static void
+preview_request (gui_world *world) {
+
+	gui_preview *preview = &world->preview;
+	GArray *points = world->graphics->user_points;
+
+	g_mutex_lock (&preview->lock);
+
+	g_atomic_int_inc (&preview->generation);
+
+	size_t size = world_snapshot (world->physics, preview->snapshot, preview->snapshot_capacity);
+
+	if (size > preview->snapshot_capacity) {
+
+		preview->snapshot = (char *)realloc(preview->snapshot, size);
+		if (preview->snapshot == NULL) {
+			printf("Memory allocation error: in function preview_request\n");
+			exit(-1);
+		}
+
+		preview->snapshot_capacity = size;
+		world_snapshot (world->physics, preview->snapshot, size);
+	}
+
+	preview->snapshot_size = size;
+	preview->level = world->physics->level;
+	preview->timestep = world->physics->timestep;
+	preview->color = world->color;
+	preview->mass = world->mass;
+
+	g_array_set_size (preview->stroke, 0);
+	g_array_append_vals (preview->stroke, points->data, points->len);
+
+	preview->pending = true;
+	g_cond_signal (&preview->wake);
+
+	g_mutex_unlock (&preview->lock);
+}
+
+/*
+  preview_cancel
+
+  stops the run of the current stroke, if any, and takes its
+  path off the screen
+
+  parameters: gui_world pointer
+ */
+static void
+preview_cancel (gui_world *world) {
+
+	gui_preview *preview = &world->preview;
+
+	g_mutex_lock (&preview->lock);
+	g_atomic_int_inc (&preview->generation);
+	preview->pending = false;
+	g_mutex_unlock (&preview->lock);
+
+	if (world->graphics->preview->len > 0) {
+		g_array_set_size (world->graphics->preview, 0);
+		gtk_widget_queue_draw (world->graphics->drawing_screen);
+	}
+}
+
+/*
+  preview_worker
+
+  thread that runs the preview requests, each in a world of
+  its own that is only touched by this thread.  A run stops
+  when the stroke hits the target, the round settles, the
+  body leaves the level, PREVIEW_SECONDS have been simulated
+  or a newer request comes in.
+
+  parameters: gui_world pointer
+
+  returns: NULL
+ */
+static gpointer
+preview_worker (gpointer data) {
+
+	gui_world *world = (gui_world *)data;
+	gui_preview *preview = &world->preview;
+
+	world_status *physics = NULL;
+	char *snapshot = NULL;
+	size_t snapshot_capacity = 0;
+	GArray *stroke = g_array_new (FALSE, FALSE, sizeof(cpVect));
+	GArray *path = g_array_new (FALSE, FALSE, sizeof(cpVect));
+
+	while (true) {
+
+		g_mutex_lock (&preview->lock);
+
+		while (!preview->pending && !preview->quit)
+			g_cond_wait (&preview->wake, &preview->lock);
+
+		if (preview->quit) {
+			g_mutex_unlock (&preview->lock);
+			break;
+		}
+
+		// take the request so the GTK thread can write the next one
+		gint generation = g_atomic_int_get (&preview->generation);
+		size_t snapshot_size = preview->snapshot_size;
+
+		if (snapshot_size > snapshot_capacity) {
+
+			snapshot = (char *)realloc(snapshot, snapshot_size);
+			if (snapshot == NULL) {
+				printf("Memory allocation error: in function preview_worker\n");
+				exit(-1);
+			}
+
+			snapshot_capacity = snapshot_size;
+		}
+
+		memcpy (snapshot, preview->snapshot, snapshot_size);
+		g_array_set_size (stroke, 0);
+		g_array_append_vals (stroke, preview->stroke->data, preview->stroke->len);
+
+		int level = preview->level;
+		float timestep = preview->timestep;
+		COLOR color = preview->color;
+		cpFloat mass = preview->mass;
+
+		preview->pending = false;
+		g_mutex_unlock (&preview->lock);
+
+		if (physics == NULL || physics->level != level) {
+
+			if (physics != NULL)
+				world_free (physics);
+
+			physics = world_new (level, timestep);
+		}
+
+		if (!world_restore (physics, snapshot, snapshot_size))
+			continue;
+
+		int count = stroke_decimate ((cpVect *)stroke->data, stroke->len);
+		int body_id = create_user_object ((cpVect *)stroke->data, count, color, physics,
+			PLAYER_BOX_COLLISION_NUMBER, 0.7, mass);
+
+		cpBody *body = world_get_body (physics, body_id);
+		cpVect position = cpBodyGetPos (body);
+
+		g_array_set_size (path, 0);
+		g_array_append_val (path, position);
+
+		int steps = PREVIEW_SECONDS / timestep;
+		bool cancelled = false;
+
+		for (int step = 1; step <= steps && physics->status != 1 && !physics->settled; step++) {
+
+			if (g_atomic_int_get (&preview->generation) != generation) {
+				cancelled = true;
+				break;
+			}
+
+			world_update (physics);
+
+			body = world_get_body (physics, body_id);
+			if (body == NULL)
+				break;
+
+			position = cpBodyGetPos (body);
+			if (step % PREVIEW_SAMPLE == 0 || physics->status == 1)
+				g_array_append_val (path, position);
+		}
+
+		if (cancelled)
+			continue;
+
+		g_mutex_lock (&preview->lock);
+
+		if (g_atomic_int_get (&preview->generation) == generation) {
+
+			GArray *swap = preview->path;
+			preview->path = path;
+			path = swap;
+
+			preview->hit = (physics->status == 1);
+			preview->path_generation = generation;
+
+			// GTK may only be used from its own thread
+			g_idle_add (preview_show, world);
+		}
+
+		g_mutex_unlock (&preview->lock);
+	}
+
+	if (physics != NULL)
+		world_free (physics);
+
+	free (snapshot);
+	g_array_free (stroke, TRUE);
+	g_array_free (path, TRUE);
+
+	return NULL;
+}
+
+/*
+  preview_show
+
+  idle callback on the GTK thread that puts the path of the
+  last finished run on the screen, unless the stroke changed
+  since
+
+  parameters: gui_world pointer
+
+  returns: FALSE, so that it runs once
+ */
+static gboolean
+preview_show (gpointer data) {
+
+	gui_world *world = (gui_world *)data;
+	gui_preview *preview = &world->preview;
+
+	g_mutex_lock (&preview->lock);
+
+	if (preview->path_generation == g_atomic_int_get (&preview->generation)) {
+
+		g_array_set_size (world->graphics->preview, 0);
+		g_array_append_vals (world->graphics->preview, preview->path->data, preview->path->len);
+		world->graphics->preview_hit = preview->hit;
+	}
+
+	g_mutex_unlock (&preview->lock);
+
+	gtk_widget_queue_draw (world->graphics->drawing_screen);
+
+	return FALSE;
+}
+
+/*
+  cb_key_press
+
+  moves the camera with the keyboard while the drawing area has focus,
+  h toggles the performance overlay and f fast forward
+
+  parameters: gtk widget, key event and gui_world pointer
+ */
+static gboolean
+cb_key_press (GtkWidget *widget, GdkEventKey *event, gpointer data) {
+
+	gui_world *world = (gui_world *)data;
+
+	if (event->keyval == GDK_KEY_h) {
+		graphics_hud_toggle (world->graphics);
+		gtk_widget_queue_draw (world->graphics->drawing_screen);
+		return TRUE;
+	}
+
+	if (event->keyval == GDK_KEY_f) {
+		world->fast_forward = !world->fast_forward;
+		return TRUE;
+	}
+
+	return graphics_camera_key (world->graphics, event->keyval);
+}
+
+/*
+  cb_scroll
+
+  zooms the camera around the mouse
+
+  parameters: gtk widget, scroll event and gui_world pointer
+ */
+static gboolean
+cb_scroll (GtkWidget *widget, GdkEventScroll *event, gpointer data) {
+
+	gui_world *world = (gui_world *)data;
+
+	return graphics_camera_scroll (world->graphics, event->direction, event->x, event->y);
+}
+
+/*
+  headless_read_drop
+
+  reads the next drop of a drops file, one per line:
+  tick color mass n x1 y1 ... xn yn, the polygon in world
+  coordinates
+
+  parameters: the file, and where to store the tick, color,
+  mass and points of the drop
+
+  returns: false at the end of the file or on a bad line
+ */
+static bool
+headless_read_drop (FILE *file, long *tick, COLOR *color, cpFloat *mass, GArray *points) {
+
+	char color_name[16];
+	double drop_mass;
+	int count;
+
+	if (fscanf (file, "%ld %15s %lf %d", tick, color_name, &drop_mass, &count) != 4 || count < 3)
+		return false;
+
+	*color = conv_color (color_name);
+	*mass = drop_mass;
+
+	g_array_set_size (points, 0);
+
+	for (int i = 0; i < count; i++) {
+
+		double x, y;
+
+		if (fscanf (file, "%lf %lf", &x, &y) != 2)
+			return false;
+
+		cpVect point = cpv(x, y);
+		g_array_append_val (points, point);
+	}
+
+	return true;
+}
+
+/*
+  headless_main
+
+  plays the drops of a file into a level with no window, as
+  fast as it goes: each drop is added at its tick, and once
+  they are all in the world is stepped until the target is
+  hit, the round settles or HEADLESS_SECONDS go by.  Prints
+  the outcome and the step rate.
+
+  usage: gui --headless --level N --drops file
+
+  parameters: argc and *argv[] from the command line
+
+  returns: 0 if the target was hit, 1 if not
+ */
+static int
+headless_main (int argc, char *argv[]) {
+
+	int level = 0;
+	const char *drops = NULL;
+
+	for (int arg = 2; arg + 1 < argc; arg += 2) {
+
+		if (strcmp (argv[arg], "--level") == 0)
+			level = atoi (argv[arg + 1]);
+		else if (strcmp (argv[arg], "--drops") == 0)
+			drops = argv[arg + 1];
+	}
+
+	if (level < 1 || drops == NULL || argc != 6) {
+		printf("usage: gui --headless --level N --drops file\n");
+		exit(-1);
+	}
+
+	FILE *file = fopen (drops, "r");
+	if (file == NULL) {
+		perror (drops);
+		exit(-1);
+	}
+
+	world_load_levels();
+
+	cpFloat time_step = 1.0/60.0;
+	world_status *physics = world_new (level, time_step);
+	GArray *points = g_array_new (FALSE, FALSE, sizeof(cpVect));
+
+	long tick = 0, drop_tick;
+	int drop_count = 0;
+	COLOR color;
+	cpFloat mass;
+
+	gint64 start = g_get_monotonic_time ();
+
+	while (physics->status != 1 && headless_read_drop (file, &drop_tick, &color, &mass, points)) {
+
+		while (tick < drop_tick && physics->status != 1) {
+			world_update (physics);
+			tick++;
+		}
+
+		if (physics->status == 1)
+			break;
+
+		create_user_object ((cpVect *)points->data, points->len, color, physics,
+			PLAYER_BOX_COLLISION_NUMBER, 0.7, mass);
+		drop_count++;
+	}
+
+	if (physics->status != 1 && !feof (file))
+		printf("%s: stopped at a drop that cannot be read\n", drops);
+
+	long last_tick = tick + HEADLESS_SECONDS / time_step;
+
+	while (tick < last_tick && physics->status != 1 && !physics->settled) {
+		world_update (physics);
+		tick++;
+	}
+
+	double seconds = (double)(g_get_monotonic_time () - start) / G_USEC_PER_SEC;
+
+	if (physics->status == 1)
+		printf("level %d: target hit at tick %ld (%.2f s) after %d drops\n", level, tick, tick * time_step, drop_count);
+	else if (physics->settled)
+		printf("level %d: missed, settled at tick %ld (%.2f s) after %d drops\n", level, tick, tick * time_step, drop_count);
+	else
+		printf("level %d: missed, still moving at tick %ld (%.2f s) after %d drops\n", level, tick, tick * time_step, drop_count);
+
+	printf("%ld steps in %.3f s: %.0f steps/s\n", tick, seconds, (seconds > 0) ? tick / seconds : 0);
+
+	int result = (physics->status == 1) ? 0 : 1;
+
+	g_array_free (points, TRUE);
+	world_free (physics);
+	fclose (file);
+
+	return result;
+}
+
 /*
   main
 
   main function, sets up the gtk GUI, the graphics and physics worlds
-  and then calls gtk_main().
+  and then calls gtk_main().  With --headless it plays a drops file
+  with no window instead.
 
   parameters: argc and *argv[] from the command line
 */
 int
 main ( int argc, char *argv[] ) {
 
+	if (argc > 1 && strcmp (argv[1], "--headless") == 0)
+		return headless_main (argc, argv);
+
 	if (argc < 2) {
 		printf("Must include an integer for level\n");
 		exit(-1);
@@ -413,9 +1090,10 @@ main ( int argc, char *argv[] ) {
 
     cpFloat time_step = 1.0/60.0;
 
+    world_load_levels();
+
     gui_world world;
-    world.graphics = (graphics_world *) malloc(sizeof(graphics_world));
-    assert(world.graphics);
+    world.graphics = graphics_world_new ();
 	world.color = conv_color("red");
     world.physics = world_new(level, time_step);
     world.graphics -> space = world.physics -> space;
@@ -437,7 +1115,13 @@ main ( int argc, char *argv[] ) {
     world.try_number = 1;
 	world.level = level;
 	world.stop = false;
-	initialize_array (&world);
+	world.fast_forward = false;
+	world.accumulator = 0;
+	world.previous_pos = NULL;
+	world.previous_angle = NULL;
+	world.previous_capacity = 0;
+	save_poses (&world);
+	preview_start (&world);
 
 
     GtkWidget *frame;
@@ -581,6 +1265,8 @@ main ( int argc, char *argv[] ) {
     gtk_widget_add_events(da, GDK_BUTTON_RELEASE_MASK);
 	gtk_widget_add_events(da, GDK_POINTER_MOTION_MASK
 							| GDK_POINTER_MOTION_HINT_MASK);
+	gtk_widget_add_events(da, GDK_KEY_PRESS_MASK | GDK_SCROLL_MASK);
+	gtk_widget_set_can_focus(da, TRUE);
 
     /* Signals used to handle the backing surface */
     g_signal_connect (da, "draw", G_CALLBACK (draw_cb), &world);
@@ -589,12 +1275,18 @@ main ( int argc, char *argv[] ) {
 	g_signal_connect (da, "motion-notify-event", G_CALLBACK (motion_notify_event_cb), &world);
     g_signal_connect (da, "button-press-event", G_CALLBACK (cb_button_press), &world);
     g_signal_connect (da, "button-release-event", G_CALLBACK (cb_button_release), &world);
+    g_signal_connect (da, "key-press-event", G_CALLBACK (cb_key_press), &world);
+    g_signal_connect (da, "scroll-event", G_CALLBACK (cb_scroll), &world);
 
-    g_timeout_add(40, (GSourceFunc) time_handler, (gpointer) &world);
+    world.last_frame = g_get_monotonic_time ();
+    g_timeout_add(FRAME_INTERVAL, (GSourceFunc) time_handler, (gpointer) &world);
 
     gtk_widget_show_all (world.graphics -> window);
     gtk_main ();
 
+    preview_stop (&world);
+    graphics_world_free (world.graphics);
+
     //Free stuff
     
 /*
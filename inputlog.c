@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <chipmunk/chipmunk.h>
+#include "specs/common.h"
+#include "specs/physics.h"
+#include "specs/inputlog.h"
+
+#define INPUT_LOG_MAGIC "DZLOG"
+
+// 64 bit FNV-1a
+#define CHECKSUM_OFFSET 14695981039346656037ULL
+#define CHECKSUM_PRIME 1099511628211ULL
+
+/*
+	inputlog.c
+
+	writes and reads the input log of a server; see
+	specs/inputlog.h for the format. Every line is flushed
+	as it is written, so that a log is complete up to the
+	last input even if the server does not exit cleanly.
+ */
+
+//Prototypes for static functions
+static uint64_t checksum_add (uint64_t checksum, const void *data, size_t size);
+
+/*
+	Creates a log and writes its first line
+
+	Parameters:
+		*filename = file to write
+		timestep = time of one world step
+
+	Returns: the file, or NULL if it cannot be created
+ */
+FILE *
+input_log_open (const char *filename, float timestep) {
+
+	FILE *log = fopen (filename, "w");
+	if (log == NULL)
+		return NULL;
+
+	fprintf (log, "%s %d %a\n", INPUT_LOG_MAGIC, INPUT_LOG_VERSION, (double)timestep);
+	fflush (log);
+
+	return log;
+}
+
+/*
+	Records that a world of a level was built or reset
+
+	Parameters:
+		*log = log to write to
+		tick = steps taken so far
+		level = level number
+ */
+void
+input_log_level (FILE *log, long tick, int level) {
+
+	fprintf (log, "LEVEL %ld %d\n", tick, level);
+	fflush (log);
+}
+
+/*
+	Records a polygon drawn by a player
+
+	Parameters:
+		*log = log to write to
+		tick = steps taken so far
+		color = color of the body
+		mass = mass of the body
+		*vectors = outline in world coordinates, as received
+		vector_count = number of points
+ */
+void
+input_log_body (FILE *log, long tick, COLOR color, cpFloat mass, cpVect *vectors, int vector_count) {
+
+	fprintf (log, "BODY %ld %s %a %d", tick, color_to_string (color), (double)mass, vector_count);
+
+	for (int i = 0; i < vector_count; i++)
+		fprintf (log, " %a %a", (double)vectors[i].x, (double)vectors[i].y);
+
+	fprintf (log, "\n");
+	fflush (log);
+}
+
+/*
+	Records a change of the solver iterations
+
+	Parameters:
+		*log = log to write to
+		tick = steps taken so far
+		iterations = new number of iterations
+ */
+void
+input_log_iterations (FILE *log, long tick, int iterations) {
+
+	fprintf (log, "ITERATIONS %ld %d\n", tick, iterations);
+	fflush (log);
+}
+
+/*
+	Records the state a round ended in
+
+	Parameters:
+		*log = log to write to
+		tick = steps taken so far
+		*world = world of the round
+ */
+void
+input_log_outcome (FILE *log, long tick, world_status *world) {
+
+	fprintf (log, "OUTCOME %ld %d %d %016llx\n", tick, world->level, world->status,
+		(unsigned long long)world_checksum (world));
+	fflush (log);
+}
+
+/*
+	Opens a log for reading
+
+	Parameters:
+		*filename = log to read
+		*timestep = set to the time of one world step
+
+	Returns: the file, or NULL if it is not a log of this
+	version
+ */
+FILE *
+input_log_read_open (const char *filename, float *timestep) {
+
+	FILE *log = fopen (filename, "r");
+	if (log == NULL)
+		return NULL;
+
+	char magic[8];
+	int version;
+	double step;
+
+	if (fscanf (log, "%7s %d %lf", magic, &version, &step) != 3
+		|| strcmp (magic, INPUT_LOG_MAGIC) != 0 || version != INPUT_LOG_VERSION) {
+		fclose (log);
+		return NULL;
+	}
+
+	*timestep = step;
+
+	return log;
+}
+
+/*
+	Reads the next event of a log
+
+	Parameters:
+		*log = log opened by input_log_read_open
+		*event = filled with the event
+
+	Returns: false at the end of the log or on a bad line
+ */
+bool
+input_log_read (FILE *log, input_event *event) {
+
+	char kind[16];
+
+	if (fscanf (log, "%15s %ld", kind, &event->tick) != 2)
+		return false;
+
+	if (strcmp (kind, "LEVEL") == 0) {
+		event->kind = INPUT_LEVEL;
+		return fscanf (log, "%d", &event->level) == 1;
+	}
+
+	if (strcmp (kind, "ITERATIONS") == 0) {
+		event->kind = INPUT_ITERATIONS;
+		return fscanf (log, "%d", &event->iterations) == 1;
+	}
+
+	if (strcmp (kind, "OUTCOME") == 0) {
+
+		unsigned long long checksum;
+
+		event->kind = INPUT_OUTCOME;
+		if (fscanf (log, "%d %d %llx", &event->level, &event->status, &checksum) != 3)
+			return false;
+
+		event->checksum = checksum;
+		return true;
+	}
+
+	if (strcmp (kind, "BODY") == 0) {
+
+		char color[16];
+		double mass;
+
+		event->kind = INPUT_BODY;
+		if (fscanf (log, "%15s %lf %d", color, &mass, &event->vector_count) != 3
+			|| event->vector_count < 1)
+			return false;
+
+		event->color = conv_color (color);
+		event->mass = mass;
+
+		if (event->vector_count > event->vector_capacity) {
+
+			event->vectors = (cpVect *)realloc(event->vectors, event->vector_count * sizeof(cpVect));
+			if (event->vectors == NULL) {
+				printf("Memory allocation error: in function input_log_read\n");
+				exit(-1);
+			}
+
+			event->vector_capacity = event->vector_count;
+		}
+
+		for (int i = 0; i < event->vector_count; i++) {
+
+			double x, y;
+
+			if (fscanf (log, "%lf %lf", &x, &y) != 2)
+				return false;
+
+			event->vectors[i] = cpv(x, y);
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+/*
+	Frees the vectors kept in an event
+
+	Parameters:
+		*event = event filled by input_log_read
+ */
+void
+input_event_free (input_event *event) {
+
+	free (event->vectors);
+	event->vectors = NULL;
+	event->vector_capacity = 0;
+}
+
+/*
+	Hashes the id, position and angle of every body of the
+	world that can move
+
+	Parameters:
+		*world = world to hash
+
+	Returns: the checksum
+ */
+uint64_t
+world_checksum (world_status *world) {
+
+	uint64_t checksum = CHECKSUM_OFFSET;
+
+	for (int id = 0; id < world->bodies.count; id++) {
+
+		cpBody *body = world->bodies.body[id];
+
+		if (body == NULL || cpBodyIsStatic (body))
+			continue;
+
+		cpVect pos = cpBodyGetPos (body);
+		cpFloat angle = cpBodyGetAngle (body);
+
+		checksum = checksum_add (checksum, &id, sizeof id);
+		checksum = checksum_add (checksum, &pos, sizeof pos);
+		checksum = checksum_add (checksum, &angle, sizeof angle);
+	}
+
+	return checksum;
+}
+
+/*
+	Adds bytes to an FNV-1a hash
+
+	Parameters:
+		checksum = hash so far
+		*data = bytes to add
+		size = number of bytes
+
+	Returns: the new hash
+ */
+static uint64_t
+checksum_add (uint64_t checksum, const void *data, size_t size) {
+
+	const unsigned char *bytes = (const unsigned char *)data;
+
+	for (size_t i = 0; i < size; i++) {
+		checksum ^= bytes[i];
+		checksum *= CHECKSUM_PRIME;
+	}
+
+	return checksum;
+}
@@ -0,0 +1,753 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <chipmunk/chipmunk.h>
+#include "specs/common.h"
+#include "specs/physics.h"
+#include "specs/convex.h"
+#include "specs/level.h"
+
+#define LINE_RADIUS 0.5
+
+/*
+	level.c
+
+	reads levels, either from the .lvl text format or
+	from the compiled .lvlb format written by levelc,
+	into level descriptors that physics.c builds
+	worlds from.
+ */
+
+//Prototypes for static functions
+static level_data *level_data_new (void);
+static level_body *level_body_add (level_data *level, level_shape shape, int collision, const char *color, int vertex_count);
+static cpVect *level_vertices (level_data *level, level_body *body);
+static void level_set_bb (level_data *level, level_body *body);
+static void level_custom_read (FILE *ifile, level_data *level, int collision);
+static void level_box_read (FILE *ifile, level_data *level, int collision);
+static void level_line_read (FILE *ifile, level_data *level, int collision);
+static void level_ground_read (FILE *ifile, level_data *level);
+static void level_zone_read (FILE *ifile, level_data *level);
+static void level_sleep_read (FILE *ifile, level_data *level);
+static void level_index_read (FILE *ifile, level_data *level);
+static void level_solver_read (FILE *ifile, level_data *level, const char *keyword);
+static bool level_body_valid (level_body *body, uint32_t vertex_count);
+
+// growable arrays of a level being parsed
+static int body_capacity;
+static int vertex_capacity;
+
+/*
+	allocates an empty level with room for a few
+	bodies and vertices
+
+	Parameters: none
+
+	Returns: the new level
+ */
+static level_data *
+level_data_new (void) {
+
+	level_data *level = (level_data *)malloc(sizeof(level_data));
+	level_header *header = (level_header *)calloc(1, sizeof(level_header));
+
+	body_capacity = 8;
+	vertex_capacity = 32;
+
+	if (level == NULL || header == NULL) {
+		printf("Memory allocation error: in function level_data_new\n");
+		exit(-1);
+	}
+
+	level->bodies = (level_body *)malloc(body_capacity * sizeof(level_body));
+	level->vertices = (cpVect *)malloc(vertex_capacity * sizeof(cpVect));
+
+	if (level->bodies == NULL || level->vertices == NULL) {
+		printf("Memory allocation error: in function level_data_new\n");
+		exit(-1);
+	}
+
+	memcpy(header->magic, LEVEL_MAGIC, 4);
+	header->version = LEVEL_VERSION;
+	header->float_size = sizeof(cpFloat);
+	header->sleep_time = LEVEL_SLEEP_TIME;
+	header->idle_speed = LEVEL_IDLE_SPEED;
+	header->settle_time = LEVEL_SETTLE_TIME;
+	header->gravity_x = LEVEL_GRAVITY_X;
+	header->gravity_y = LEVEL_GRAVITY_Y;
+	header->iterations = LEVEL_ITERATIONS;
+	header->collision_slop = LEVEL_COLLISION_SLOP;
+	header->collision_bias = LEVEL_COLLISION_BIAS;
+	header->damping = LEVEL_DAMPING;
+
+	level->header = header;
+	level->mapping = NULL;
+	level->mapping_size = 0;
+
+	return level;
+}
+
+/*
+	appends a body and room for its vertices to a level
+	being parsed
+
+	Parameters:
+		*level = level being parsed
+		shape = kind of body
+		collision = collision type of its shapes
+		*color = color name from the file
+		vertex_count = number of outline vertices
+
+	Returns: the new body, its vertices still unset
+ */
+static level_body *
+level_body_add (level_data *level, level_shape shape, int collision, const char *color, int vertex_count) {
+
+	level_header *header = level->header;
+
+	if (header->body_count == body_capacity) {
+		body_capacity *= 2;
+		level->bodies = (level_body *)realloc(level->bodies, body_capacity * sizeof(level_body));
+		if (level->bodies == NULL) {
+			printf("Memory allocation error: in function level_body_add\n");
+			exit(-1);
+		}
+	}
+
+	while (header->vertex_count + vertex_count > vertex_capacity) {
+		vertex_capacity *= 2;
+		level->vertices = (cpVect *)realloc(level->vertices, vertex_capacity * sizeof(cpVect));
+		if (level->vertices == NULL) {
+			printf("Memory allocation error: in function level_body_add\n");
+			exit(-1);
+		}
+	}
+
+	level_body *body = &level->bodies[header->body_count++];
+	memset(body, 0, sizeof(level_body));
+
+	body->shape = shape;
+	body->collision = collision;
+	body->color = conv_color(color);
+	body->vertex_offset = header->vertex_count;
+	body->vertex_count = vertex_count;
+
+	header->vertex_count += vertex_count;
+
+	return body;
+}
+
+/*
+	returns the vertices of a body of a level
+
+	Parameters:
+		*level = level the body belongs to
+		*body = body of the level
+
+	Returns: pointer to the first of its vertices
+ */
+static cpVect *
+level_vertices (level_data *level, level_body *body) {
+
+	return level->vertices + body->vertex_offset;
+}
+
+/*
+	computes the world space bounding box of a body from
+	its vertices, which must be set already
+
+	Parameters:
+		*level = level the body belongs to
+		*body = body to update
+
+	Returns: nothing
+ */
+static void
+level_set_bb (level_data *level, level_body *body) {
+
+	cpVect *vertices = level_vertices(level, body);
+	cpVect offset = (body->shape == LEVEL_GROUND) ? cpvzero : body->center;
+
+	cpBB bb = cpBBNewForCircle(cpvadd(vertices[0], offset), LINE_RADIUS);
+
+	for (int i = 1; i < body->vertex_count; i++)
+		bb = cpBBMerge(bb, cpBBNewForCircle(cpvadd(vertices[i], offset), LINE_RADIUS));
+
+	body->bb = bb;
+}
+
+/*
+	Reads the level from the file.
+
+	Parameters:
+    	*ifile = FILE to read level from
+
+	Returns: the level, to be released with level_free
+ */
+level_data *
+level_parse (FILE *ifile) {
+
+	level_data *level = level_data_new();
+
+	char input[100];
+	int collision_type = OBSTACLE_COLLISION_NUMBER;
+	level_mode mode = LEVEL_DYNAMIC;
+	cpVect velocity = cpvzero;
+	float vx, vy, angular_velocity = 0;
+
+	while (fscanf(ifile, "%s", input) != EOF) {
+
+		uint32_t body_count = level->header->body_count;
+
+		if (strcmp (input, "TARGET") == 0) {
+			collision_type = TARGET_COLLISION_NUMBER;
+		}
+		else if (strcmp (input, "OBSTACLE") == 0) {
+			collision_type = OBSTACLE_COLLISION_NUMBER;
+		}
+		else if (strcmp (input, "GROUND") == 0) {
+			level_ground_read (ifile, level);
+		}
+		else if (strcmp (input, "CUSTOM") == 0) {
+			level_custom_read (ifile, level, collision_type);
+		}
+		else if (strcmp (input, "BOX") == 0) {
+			level_box_read (ifile, level, collision_type);
+		}
+		else if (strcmp (input, "LINE") == 0) {
+			level_line_read (ifile, level, collision_type);
+		}
+		else if (strcmp (input, "ZONE") == 0) {
+			level_zone_read (ifile, level);
+		}
+		else if (strcmp (input, "SLEEP") == 0) {
+			level_sleep_read (ifile, level);
+		}
+		else if (strcmp (input, "SETTLE") == 0) {
+			float time;
+			fscanf(ifile, "%f", &time);
+			level->header->settle_time = time > 0 ? time : 0;
+		}
+		else if (strcmp (input, "INDEX") == 0) {
+			level_index_read (ifile, level);
+		}
+		else if (strcmp (input, "DYNAMIC") == 0) {
+			mode = LEVEL_DYNAMIC;
+		}
+		else if (strcmp (input, "STATIC") == 0) {
+			mode = LEVEL_STATIC;
+		}
+		else if (strcmp (input, "KINEMATIC") == 0) {
+			fscanf(ifile, "%f%f%f", &vx, &vy, &angular_velocity);
+			velocity = cpv(vx, vy);
+			mode = LEVEL_KINEMATIC;
+		}
+		else {
+			level_solver_read (ifile, level, input);
+		}
+
+		// the ground always belongs to the space's static body
+		if (level->header->body_count > body_count && level->bodies[body_count].shape != LEVEL_GROUND) {
+
+			level_body *body = &level->bodies[body_count];
+
+			body->mode = mode;
+
+			if (mode == LEVEL_KINEMATIC) {
+				body->velocity = velocity;
+				body->angular_velocity = angular_velocity;
+			}
+		}
+	}
+
+	return level;
+}
+
+/*
+	Reads the zone from the file.
+
+	Parameters:
+    	*ifile = FILE to read level from
+    	*level = level being parsed
+ */
+static void
+level_zone_read (FILE *ifile, level_data *level) {
+
+	float x1, y1, x2, y2;
+	fscanf(ifile, "%f%f%f%f", &x1, &y1, &x2, &y2);
+
+	level->header->drawing_box_x1 = x1;
+	level->header->drawing_box_y1 = y1;
+	level->header->drawing_box_x2 = x2;
+	level->header->drawing_box_y2 = y2;
+
+	level->header->drawing_box = true;
+}
+
+/*
+	Reads the sleeping thresholds from the file: the time
+	a body has to stay under the idle speed before it
+	falls asleep, and the idle speed.
+
+	Parameters:
+    	*ifile = FILE to read level from
+    	*level = level being parsed
+ */
+static void
+level_sleep_read (FILE *ifile, level_data *level) {
+
+	float time, speed;
+	fscanf(ifile, "%f%f", &time, &speed);
+
+	level->header->sleep_time = time > 0 ? time : INFINITY;
+	level->header->idle_speed = speed > 0 ? speed : 0;
+}
+
+/*
+	Reads the spatial index to use from the file: TREE,
+	AUTO, or HASH followed by the cell size and count.
+
+	Parameters:
+    	*ifile = FILE to read level from
+    	*level = level being parsed
+ */
+static void
+level_index_read (FILE *ifile, level_data *level) {
+
+	char input[10];
+	fscanf(ifile, "%9s", input);
+
+	if (strcmp (input, "TREE") == 0) {
+		level->header->index = LEVEL_INDEX_TREE;
+	}
+	else if (strcmp (input, "HASH") == 0) {
+
+		float dim;
+		int count;
+		fscanf(ifile, "%f%d", &dim, &count);
+
+		level->header->index = LEVEL_INDEX_HASH;
+		level->header->index_dim = dim > 0 ? dim : 0;
+		level->header->index_count = count > 0 ? count : 0;
+	}
+	else {
+		level->header->index = LEVEL_INDEX_AUTO;
+	}
+}
+
+/*
+	Reads a solver setting from the file if keyword is one
+	of GRAVITY, ITERATIONS, SLOP, BIAS or DAMPING, and
+	ignores it otherwise.
+
+	Parameters:
+    	*ifile = FILE to read level from
+    	*level = level being parsed
+    	*keyword = word just read
+ */
+static void
+level_solver_read (FILE *ifile, level_data *level, const char *keyword) {
+
+	level_header *header = level->header;
+	float x, y;
+	int iterations;
+
+	if (strcmp (keyword, "GRAVITY") == 0) {
+		fscanf(ifile, "%f%f", &x, &y);
+		header->gravity_x = x;
+		header->gravity_y = y;
+	}
+	else if (strcmp (keyword, "ITERATIONS") == 0) {
+		fscanf(ifile, "%d", &iterations);
+		header->iterations = iterations > 0 ? iterations : LEVEL_ITERATIONS;
+	}
+	else if (strcmp (keyword, "SLOP") == 0) {
+		fscanf(ifile, "%f", &x);
+		header->collision_slop = x > 0 ? x : 0;
+	}
+	else if (strcmp (keyword, "BIAS") == 0) {
+		fscanf(ifile, "%f", &x);
+		header->collision_bias = (x > 0 && x < 1) ? x : LEVEL_COLLISION_BIAS;
+	}
+	else if (strcmp (keyword, "DAMPING") == 0) {
+		fscanf(ifile, "%f", &x);
+		header->damping = (x > 0 && x <= 1) ? x : LEVEL_DAMPING;
+	}
+}
+
+/*
+	reads a custom body from the .lvl file
+
+	Parameters:
+		*ifile = file pointer to the level
+		*level = level being parsed
+		collision = type of collision
+ */
+static void
+level_custom_read (FILE *ifile, level_data *level, int collision) {
+
+	char input[10], input2[10];
+	cpVect *vectors = (cpVect *)malloc(sizeof(cpVect));
+	if (vectors == NULL) {
+		printf("Memeory allocation error in function level_custom_read\n");
+		exit(-1);
+	}
+
+	int capacity = 1;
+	int size = 0;
+	strcpy(input, "1");
+	strcpy(input2, "1");
+
+	while (strcmp(input, "z") != 0) {
+
+		fscanf(ifile, "%s%s", input, input2);
+
+		if (strcmp(input, "z") != 0) {
+			size++;
+			if (size == capacity) {
+				capacity *= 2;
+				vectors = (cpVect *)realloc(vectors, capacity * sizeof(cpVect));
+				if (vectors == NULL) {
+					printf("Memory allocation error: in function level_custom_read\n");
+					exit(-1);
+				}
+			}
+			int x = atoi(input);
+			int y = atoi(input2);
+			vectors[size-1] = cpv( x, y );
+		}
+	}
+
+	char color[10];
+	fscanf( ifile, "%s", color );
+
+	float mu, mass;
+	fscanf( ifile, "%f%f", &mu, &mass );
+
+	level_body *body = level_body_add(level, LEVEL_CUSTOM, collision, color, size);
+	cpVect *vertices = level_vertices(level, body);
+
+	// like a drawing in create_user_object, the body sits at the centroid
+	// of its convex pieces, with their real moment; outlines that cannot
+	// be decomposed keep the old estimates
+	convex_pieces *pieces = convex_decompose (vectors, size);
+
+	cpVect center = (pieces != NULL) ? pieces->centroid : center_calculation (vectors, size);
+
+	for (int i = 0; i < size; i++)
+		vertices[i] = cpvsub (vectors[i], center);
+
+	body->mu = mu;
+	body->mass = mass;
+	body->center = center;
+	body->moment = (pieces != NULL) ? convex_moment (pieces, mass, center)
+		: moment_calculation (vertices, size, center, mass);
+	level_set_bb(level, body);
+
+	if (pieces != NULL)
+		convex_free (pieces);
+
+	free(vectors);
+}
+
+/*
+	reads a box body from the .lvl file
+
+	Parameters:
+		*ifile = file pointer to the level
+		*level = level being parsed
+		collision = type of collision
+ */
+static void
+level_box_read (FILE *ifile, level_data *level, int collision) {
+
+	float x1, y1, width, height;
+	fscanf( ifile, "%f%f%f%f", &x1, &y1, &width, &height );
+
+	char color[10];
+	fscanf( ifile, "%s", color );
+
+	float mu, mass;
+	fscanf( ifile, "%f%f", &mu, &mass );
+
+	level_body *body = level_body_add(level, LEVEL_BOX, collision, color, 4);
+	cpVect *vertices = level_vertices(level, body);
+
+	vertices[0] = cpv(width/2, height/2);
+	vertices[1] = cpv(width/2, -height/2);
+	vertices[2] = cpv(-width/2, -height/2);
+	vertices[3] = cpv(-width/2, height/2);
+
+	body->mu = mu;
+	body->mass = mass;
+	body->center = cpv(x1, y1);
+	body->moment = cpMomentForBox(mass, width, height);
+	level_set_bb(level, body);
+}
+
+/*
+	reads a line body from the .lvl file
+
+	Parameters:
+		*ifile = file pointer to the level
+		*level = level being parsed
+		collision = type of collision
+ */
+static void
+level_line_read (FILE *ifile, level_data *level, int collision) {
+
+	float x1, y1, x2, y2;
+	fscanf( ifile, "%f%f%f%f", &x1, &y1, &x2, &y2 );
+	cpVect center = cpv((x1 + x2) / 2, (y1 + y2) / 2);
+
+	char color[10];
+	fscanf(ifile, "%s", color);
+
+	float mu;
+	fscanf(ifile, "%f", &mu);
+
+	float mass;
+	fscanf(ifile, "%f", &mass);
+
+	level_body *body = level_body_add(level, LEVEL_LINE, collision, color, 2);
+	cpVect *vertices = level_vertices(level, body);
+
+	//These two vects (a and b) are relative to center
+	vertices[0] = cpv(x1 - center.x, y1 - center.y);
+	vertices[1] = cpv(x2 - center.x, y2 - center.y);
+
+	body->mu = mu;
+	body->mass = mass;
+	body->center = center;
+	body->moment = cpMomentForSegment(mass, vertices[0], vertices[1]);
+	level_set_bb(level, body);
+}
+
+/*
+  Reads the ground from the input file.
+
+  Parameters:
+      *ifile = FILE pointer to input file
+      *level = level being parsed
+ */
+static void
+level_ground_read (FILE *ifile, level_data *level) {
+
+	char input[20];
+
+	float x1, y1, x2, y2, mu;
+
+	fscanf(ifile, "%f%f%f%f", &x1, &y1, &x2, &y2);
+
+	fscanf(ifile, "%s", input);
+
+	fscanf(ifile, "%f", &mu);
+
+	level_body *body = level_body_add(level, LEVEL_GROUND, 0, input, 2);
+	cpVect *vertices = level_vertices(level, body);
+
+	vertices[0] = cpv(x1, y1);
+	vertices[1] = cpv(x2, y2);
+
+	body->mu = mu;
+	body->mass = INFINITY;
+	body->moment = INFINITY;
+	body->center = cpvzero;
+	level_set_bb(level, body);
+}
+
+/*
+	checks that a body of a compiled level is one the text
+	parser could have written: known shape, mode and color,
+	and enough vertices, all within the level
+
+	Parameters:
+		*body = body of the mapped level
+		vertex_count = vertices of the whole level
+
+	Returns: true if the body can be built as it is
+ */
+static bool
+level_body_valid (level_body *body, uint32_t vertex_count) {
+
+	if (body->shape > LEVEL_GROUND || body->mode > LEVEL_KINEMATIC || body->color > GREEN)
+		return false;
+
+	if (body->vertex_count > vertex_count || body->vertex_offset > vertex_count - body->vertex_count)
+		return false;
+
+	if (body->shape == LEVEL_LINE || body->shape == LEVEL_GROUND)
+		return body->vertex_count == 2;
+
+	if (body->shape == LEVEL_BOX)
+		return body->vertex_count == 4;
+
+	return body->vertex_count >= 1;
+}
+
+/*
+	Maps a compiled level read-only and checks that it
+	can be used as it is.
+
+	Parameters:
+		*filename = compiled level
+		*source = text level it was compiled from, or NULL
+
+	Returns: the level, or NULL if it cannot be used
+ */
+level_data *
+level_map (const char *filename, const char *source) {
+
+	int fd = open(filename, O_RDONLY);
+
+	if (fd == -1)
+		return NULL;
+
+	struct stat compiled, text;
+
+	if (fstat(fd, &compiled) == -1 || compiled.st_size < sizeof(level_header)) {
+		close(fd);
+		return NULL;
+	}
+
+	// a level edited since it was compiled is read from the text instead
+	if (source != NULL && stat(source, &text) == 0 && text.st_mtime > compiled.st_mtime) {
+		close(fd);
+		return NULL;
+	}
+
+	size_t size = compiled.st_size;
+	void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+		return NULL;
+
+	level_header *header = (level_header *)mapping;
+
+	size_t expected = sizeof(level_header) + (size_t)header->body_count * sizeof(level_body)
+		+ (size_t)header->vertex_count * sizeof(cpVect);
+
+	bool valid = memcmp(header->magic, LEVEL_MAGIC, 4) == 0
+		&& header->version == LEVEL_VERSION
+		&& header->float_size == sizeof(cpFloat)
+		&& header->index <= LEVEL_INDEX_HASH
+		&& expected == size;
+
+	level_body *bodies = (level_body *)(header + 1);
+
+	for (uint32_t i = 0; valid && i < header->body_count; i++)
+		valid = level_body_valid (&bodies[i], header->vertex_count);
+
+	if (!valid) {
+		munmap(mapping, size);
+		return NULL;
+	}
+
+	level_data *level = (level_data *)malloc(sizeof(level_data));
+	if (level == NULL) {
+		printf("Memory allocation error: in function level_map\n");
+		exit(-1);
+	}
+
+	level->header = header;
+	level->bodies = bodies;
+	level->vertices = (cpVect *)(bodies + header->body_count);
+	level->mapping = mapping;
+	level->mapping_size = size;
+
+	return level;
+}
+
+/*
+	Loads a level by number, preferring the compiled
+	file over the text one.
+
+	Parameters:
+		level = level number
+
+	Returns: the level, or NULL if it could not be read
+ */
+level_data *
+level_load (int level) {
+
+	char filename[40], compiled[40];
+
+	sprintf( filename, "level%i.lvl", level );
+	sprintf( compiled, "level%i.lvlb", level );
+
+	level_data *result = level_map (compiled, filename);
+
+	if (result != NULL)
+		return result;
+
+	FILE *ifile;
+
+	if ((ifile = fopen (filename, "r")) == NULL)
+		return NULL;
+
+	result = level_parse (ifile);
+	fclose (ifile);
+
+	return result;
+}
+
+/*
+	Writes a level in the compiled format.
+
+	Parameters:
+		*level = level to write
+		*filename = file to write to
+
+	Returns: true if the whole file was written
+ */
+bool
+level_write (level_data *level, const char *filename) {
+
+	FILE *ofile;
+
+	if ((ofile = fopen (filename, "wb")) == NULL)
+		return false;
+
+	level_header *header = level->header;
+
+	bool written = fwrite(header, sizeof(level_header), 1, ofile) == 1
+		&& fwrite(level->bodies, sizeof(level_body), header->body_count, ofile) == header->body_count
+		&& fwrite(level->vertices, sizeof(cpVect), header->vertex_count, ofile) == header->vertex_count;
+
+	return (fclose (ofile) == 0) && written;
+}
+
+/*
+	Releases a level, unmapping it if it was mapped.
+
+	Parameters:
+		*level = level to release
+
+	Returns: nothing
+ */
+void
+level_free (level_data *level) {
+
+	if (level == NULL)
+		return;
+
+	if (level->mapping != NULL) {
+		munmap(level->mapping, level->mapping_size);
+	}
+	else {
+		free(level->header);
+		free(level->bodies);
+		free(level->vertices);
+	}
+
+	free(level);
+}
@@ -0,0 +1,86 @@
+#include <chipmunk/chipmunk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "specs/common.h"
+#include "specs/physics.h"
+#include "specs/level.h"
+
+/*
+	levelc.c
+
+	level compiler. Parses each .lvl text file given on the
+	command line and writes it next to it as a .lvlb file,
+	which world_new maps instead of parsing the text.
+
+	usage: levelc level1.lvl [level2.lvl ...]
+ */
+
+//function prototypes
+static bool levelc_compile (const char *source);
+
+/*
+	compiles one level
+
+	Parameters:
+		*source = path of the .lvl file
+
+	Returns: true if the compiled file was written
+ */
+static bool
+levelc_compile (const char *source) {
+
+	FILE *ifile;
+
+	if ((ifile = fopen (source, "r")) == NULL) {
+		printf("Could not open %s\n", source);
+		return false;
+	}
+
+	level_data *level = level_parse (ifile);
+	fclose (ifile);
+
+	char *target = (char *)malloc(strlen(source) + 2);
+	if (target == NULL) {
+		printf("Memory allocation error: in function levelc_compile\n");
+		exit(-1);
+	}
+
+	sprintf(target, "%sb", source);
+
+	bool written = level_write (level, target);
+
+	if (written)
+		printf("%s: %u bodies, %u vertices -> %s\n", source, level->header->body_count,
+			   level->header->vertex_count, target);
+	else
+		printf("Could not write %s\n", target);
+
+	free (target);
+	level_free (level);
+
+	return written;
+}
+
+/*
+	main function, compiles every level given
+
+	parameters: paths of .lvl files
+ */
+int
+main (int argc, char *argv[]) {
+
+	if (argc < 2) {
+		printf("usage: levelc level.lvl [level.lvl ...]\n");
+		exit(-1);
+	}
+
+	int failures = 0;
+
+	for (int i = 1; i < argc; i++)
+		if (!levelc_compile (argv[i]))
+			failures++;
+
+	return failures == 0 ? 0 : 1;
+}
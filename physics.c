@@ -4,169 +4,1317 @@
 #include <string.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <math.h>
 #include "specs/common.h"
 #include "specs/physics.h"
+#include "specs/level.h"
+#include "specs/convex.h"
+#include "specs/arena.h"
+#include "specs/profile.h"
 
 #define LINE_RADIUS 0.5
 
+// group of every shape that cannot move (the ground, static and kinematic
+// level bodies), so that Chipmunk never pairs two infinite masses
+#define SCENERY_GROUP 1
+
+// how far past the sides and the bottom of the level a body may go before
+// it is removed; there is no top, whatever is thrown up comes back down
+#define BOUNDS_MARGIN 50
+
+// the spatial hash is only worth it with many shapes of about the same size;
+// one much larger shape (a long ground line) covers too many cells
+#define HASH_MIN_SHAPES 32
+#define HASH_SIZE_SPREAD 4
+// room left in the hash for player drawn shapes, and cells per shape
+#define HASH_PLAYER_SHAPES 32
+#define HASH_CELLS_PER_SHAPE 10
+
+// a step is split so that no body moves more than this fraction of the
+// thinnest shape of the world in one sub-step, up to WORLD_MAX_SUBSTEPS
+#define SUBSTEP_TRAVEL 0.5
+
+// bytes of world memory malloced at a time; a level and a few player drawn
+// bodies fit in one block
+#define WORLD_ARENA_BLOCK (64 * 1024)
+
+// world_snapshot body flags
+#define SNAPSHOT_PRESENT 1
+#define SNAPSHOT_SLEEPING 2
+
+/*
+	A snapshot is a snapshot_header, one snapshot_body per
+	body id, and one snapshot_player per player drawn body
+	still in the world, in id order, each followed by its
+	outline.  Every record is a multiple of 8 bytes long.
+ */
+typedef struct {
+	int32_t level;
+	int32_t body_count; // ids in the registry, and records after this
+	int32_t next_id; // world->body_count
+	int32_t status;
+	int32_t settled;
+	int32_t player_count;
+	cpFloat rest_time;
+	cpFloat max_speed;
+} snapshot_header;
+
+typedef struct {
+	uint32_t flags;
+	uint32_t unused;
+	cpVect pos;
+	cpVect vel;
+	cpFloat angle;
+	cpFloat angular_velocity;
+} snapshot_body;
+
+typedef struct {
+	int32_t body_id;
+	uint32_t color;
+	uint32_t collision;
+	int32_t outline_count; // cpVects after the record
+	cpFloat mass;
+	cpFloat mu;
+} snapshot_player;
+
 //Prototypes for static functions
-static void world_custom_read (FILE *ifile, world_status *world, cpCollisionType collision);
-static void world_box_read (FILE *ifile, world_status *world, cpCollisionType collision);
-static void world_line_read (FILE *ifile, world_status *world, cpCollisionType collision);
-static void world_level_read (FILE *ifile, world_status *world);
-static void world_ground_read (FILE *ifile, world_status *world);
+static level_data *world_template (int level);
+static void world_build (level_data *level, world_status *world);
+static void world_build_body (world_status *world, level_data *level, uint32_t index);
+static void world_clear (world_status *world);
+static cpBody *world_alloc_body (world_status *world, cpFloat mass, cpFloat moment);
+static cpBody *world_alloc_static_body (world_status *world);
+static cpShape *world_alloc_segment (world_status *world, cpBody *body, cpVect a, cpVect b, cpFloat radius);
+static cpShape *world_alloc_poly (world_status *world, cpBody *body, int count, cpVect *vertices, cpVect offset);
+static cpShape *world_alloc_box (world_status *world, cpBody *body, cpFloat width, cpFloat height);
+static void world_destroy_shape (cpShape *shape, void *data);
+static void world_choose_index (world_status *world, level_header *header);
+static void world_measure_shape (cpShape *shape, void *data);
+static body_information *world_body_info (world_status *world, COLOR color);
+static void world_add_chain (world_status *world, cpBody *body, cpVect *vertices, int vertex_count, cpFloat mu, cpCollisionType collision);
+static void world_add_shapes (world_status *world, cpBody *body, level_shape shape, cpVect *vertices, int vertex_count, cpFloat mu, cpCollisionType collision);
+static void world_add_pieces (world_status *world, cpBody *body, convex_pieces *pieces, cpVect offset, cpFloat mu, cpCollisionType collision);
+static void world_register (world_status *world, int body_id, cpBody *body, COLOR color);
+static void world_remove_body (world_status *world, int body_id);
+static void world_set_scenery (cpBody *body, cpShape *shape, void *data);
+static void world_remove_shape (cpBody *body, cpShape *shape, void *data);
+static void world_track_thickness (world_status *world, cpFloat thickness);
+static int world_substeps (world_status *world, cpFloat kinematic_speed);
+static bool world_snapshot_matches (world_status *world, const char *records, int body_count);
+static bool world_snapshot_players_fit (const char *players, size_t size, int player_count);
+static void world_restore_players (world_status *world, const char *players, int player_count);
+static void world_first_shape (cpBody *body, cpShape *shape, void *data);
 static cpBool target_collision (cpArbiter *arbiter, cpSpace *space, void *data);
 
-// Prototypes for functions that destroy the space and free memory
-static void world_shape_post(cpSpace *space, cpShape *shape, void *unused);
-static void world_shape_free(cpShape *shape, cpSpace *space);
-static void world_constrain_post(cpSpace *space, cpConstraint *constraint, void
-				 *unused);
-static void world_constrain_free(cpConstraint *constraint, cpSpace *space);
-static void world_body_post(cpSpace *space, cpBody *body, void *unused);
-static void world_body_free(cpBody *body, cpSpace *space);
+// Prototypes for functions that destroy the space and free memory
+static void world_shape_post(cpSpace *space, cpShape *shape, void *unused);
+static void world_shape_free(cpShape *shape, cpSpace *space);
+static void world_constrain_post(cpSpace *space, cpConstraint *constraint, void
+				 *unused);
+static void world_constrain_free(cpConstraint *constraint, cpSpace *space);
+static void world_body_post(cpSpace *space, cpBody *body, void *unused);
+static void world_body_free(cpBody *body, cpSpace *space);
+
+
+// Levels parsed or mapped so far, indexed by level number.  They are never
+// modified or released, so every world of a level is built from the same one.
+static level_data **level_templates = NULL;
+static int level_template_capacity = 0;
+
+// When true bodies are built from segments only, as they were before native
+// shapes were used; kept so that step_bench can compare the two.
+static bool segment_shapes = false;
+
+// Spatial index used instead of the one the level asks for, when it is not
+// LEVEL_INDEX_AUTO; set by step_bench to compare the two.
+static level_index forced_index = LEVEL_INDEX_AUTO;
+
+// sizes of the shapes gathered by world_measure_shape
+typedef struct {
+	int count;
+	cpFloat total_size;
+	cpFloat max_size;
+} shape_sizes;
+
+
+/*
+	returns the ground from the cpSpace.
+
+	Parameters:
+		*space = cpSpace
+
+	Returns:
+		cpBody of the ground
+ */
+cpBody *world_get_ground (cpSpace *space) {
+	return space->staticBody;
+}
+
+/*
+	Checks for whether there is a collision between the target and the players's
+	boxes.
+
+	Parameters:
+    	*arbiter = cpArbiter that detects collision with targets
+    	*space = the cpSpace that simulates the game
+    	*world = world_status that represents the status of the game
+
+	Returns:
+    	cpBool that represents whether the function has finished handling the
+     	collision
+ */
+static cpBool
+target_collision (cpArbiter *arbiter, cpSpace *space, void *data) {
+
+	world_status *world = (world_status *)data;
+	world->status = 1;
+
+	return true;
+}
+
+
+/*
+	Creates a new world_status
+
+	Parameters:
+    	level = int representing the level the user has chosen
+    	timestep = the amount of time to step the world
+
+	Returns:
+		a new world_status
+ */
+world_status
+*world_new(int level, float timestep) {
+
+	world_status *world= malloc(sizeof(world_status));
+	if (world == NULL) {
+		printf("Memeory allocation error in function world_new\n");
+		exit(-1);
+	}
+
+	world->status = 2;
+	world->drawing_box_x1 = world->drawing_box_y1 = 0;
+	world->drawing_box_x2 = world->drawing_box_y2 = 0;
+	world->drawing_box = false;
+	world->timestep = timestep;
+	world->body_count = 0;
+	world->level = level;
+	world->settled = false;
+	world->rest_time = 0;
+	world->min_thickness = INFINITY;
+	world->max_speed = 0;
+	world->substeps = 1;
+	for (int i = 0; i <= WORLD_MAX_SUBSTEPS; i++)
+		world->substep_counts[i] = 0;
+	world->arena = arena_new (WORLD_ARENA_BLOCK);
+	world->profile = NULL;
+	memset (&world->sample, 0, sizeof world->sample);
+	world->bodies.count = world->bodies.capacity = 0;
+	world->bodies.body = NULL;
+	world->bodies.color = NULL;
+	world->bodies.sent_pos = NULL;
+	world->bodies.sent_angle = NULL;
+	world->bodies.sent_vel = NULL;
+	world->bodies.removed = NULL;
+	world->space = cpSpaceNew();
+
+	level_data *data = world_template (level);
+
+	if (data == NULL)
+		exit(-1);
+	
+	level_header *header = data->header;
+
+	cpSpaceSetGravity (world->space, cpv(header->gravity_x, header->gravity_y)); //Set gravity
+	cpSpaceSetIterations (world->space, header->iterations);
+	cpSpaceSetCollisionSlop (world->space, header->collision_slop);
+	cpSpaceSetDamping (world->space, header->damping);
+
+	if (header->collision_bias > 0)
+		cpSpaceSetCollisionBias (world->space, header->collision_bias);
+
+	world->iterations = header->iterations;
+
+	// bodies at rest for long enough sleep and cost nothing to step
+	cpSpaceSetSleepTimeThreshold (world->space, header->sleep_time);
+	cpSpaceSetIdleSpeedThreshold (world->space, header->idle_speed);
+	world->settle_time = header->settle_time;
+
+	world_build (data, world);
+	world_choose_index (world, header);
+
+	// player drawn bodies go after this, and are released by rewinding to it
+	world->player_mark = arena_mark (world->arena);
+
+	cpSpaceAddCollisionHandler (world->space, TARGET_COLLISION_NUMBER,
+				    PLAYER_BOX_COLLISION_NUMBER,
+				    target_collision, NULL, NULL, NULL, world);
+
+	return world;
+}
+
+/*
+	Restarts the level of the world in place.
+
+	Parameters:
+		*world = world status to restart
+ */
+void
+world_reset (world_status *world) {
+
+	level_data *level = world_template (world->level);
+
+	world->status = 2;
+	world->settled = false;
+	world->rest_time = 0;
+
+	// a level body that left the bounds was removed, and its memory is in
+	// the middle of the arena, so the whole level is built again
+	for (int i = 0; i < world->level_body_count; i++) {
+
+		if (world->bodies.body[i] == NULL && level->bodies[i].shape != LEVEL_GROUND) {
+
+			world_clear (world);
+			arena_rewind (world->arena, 0);
+			world->body_count = 0;
+			world->bodies.count = 0;
+			world_build (level, world);
+			world->player_mark = arena_mark (world->arena);
+			return;
+		}
+	}
+
+	// every player slot is left NULL, so that no id past the level bodies
+	// can reach a body of the rewound arena
+	for (int id = world->level_body_count; id < world->bodies.count; id++) {
+		if (world->bodies.body[id] != NULL)
+			world_remove_body (world, id);
+		world->bodies.body[id] = NULL;
+	}
+
+	// releases the player bodies, their shapes and outlines
+	arena_rewind (world->arena, world->player_mark);
+
+	for (int i = 0; i < world->level_body_count; i++) {
+
+		cpBody *body = world->bodies.body[i];
+		level_body *initial = &level->bodies[i];
+
+		if (initial->shape == LEVEL_GROUND || initial->mode == LEVEL_STATIC)
+			continue;
+
+		if (initial->mode == LEVEL_KINEMATIC) {
+			cpBodySetPos (body, initial->center);
+			cpBodySetAngle (body, 0);
+			cpBodySetVel (body, initial->velocity);
+			cpBodySetAngVel (body, initial->angular_velocity);
+			cpSpaceReindexShapesForBody (world->space, body);
+			continue;
+		}
+
+		cpBodyActivate (body);
+		cpBodySetPos (body, initial->center);
+		cpBodySetAngle (body, 0);
+		cpBodySetVel (body, cpvzero);
+		cpBodySetAngVel (body, 0);
+		cpBodyResetForces (body);
+		cpSpaceReindexShapesForBody (world->space, body);
+	}
+
+	world->body_count = world->level_body_count;
+	world->bodies.count = world->level_body_count;
+}
+
+/*
+	Removes every body and shape of the world from its
+	space, the ground and rogue bodies included.
+
+	Parameters:
+		*world = world to empty
+ */
+static void
+world_clear (world_status *world) {
+
+	for (int id = 0; id < world->bodies.count; id++)
+		if (world->bodies.body[id] != NULL)
+			world_remove_body (world, id);
+
+	cpBodyEachShape (world->space->staticBody, world_remove_shape, world->space);
+}
+
+/*
+	Finds a body of the world by its id.
+
+	Parameters:
+		*world = world status to search
+		body_id = id given by create_user_object or the level
+
+	Returns: the body, or NULL if there is none with that id
+ */
+cpBody *
+world_get_body (world_status *world, int body_id) {
+
+	if (body_id < 0 || body_id >= world->bodies.count)
+		return NULL;
+
+	return world->bodies.body[body_id];
+}
+
+/*
+	Enters a body in the registry of the world, growing it
+	when the id is past its end.  The body has not been
+	sent to anyone yet.
+
+	Parameters:
+		*world = world the body belongs to
+		body_id = id of the body
+		*body = the body, NULL for the ground
+		color = color of the body
+ */
+static void
+world_register (world_status *world, int body_id, cpBody *body, COLOR color) {
+
+	body_registry *bodies = &world->bodies;
+
+	if (body_id >= bodies->capacity) {
+
+		int capacity = (bodies->capacity > 0) ? bodies->capacity : 16;
+		while (capacity <= body_id)
+			capacity *= 2;
+
+		bodies->body = (cpBody **)realloc(bodies->body, capacity * sizeof(cpBody *));
+		bodies->color = (COLOR *)realloc(bodies->color, capacity * sizeof(COLOR));
+		bodies->sent_pos = (cpVect *)realloc(bodies->sent_pos, capacity * sizeof(cpVect));
+		bodies->sent_angle = (cpFloat *)realloc(bodies->sent_angle, capacity * sizeof(cpFloat));
+		bodies->sent_vel = (cpVect *)realloc(bodies->sent_vel, capacity * sizeof(cpVect));
+		bodies->removed = (bool *)realloc(bodies->removed, capacity * sizeof(bool));
+
+		if (bodies->body == NULL || bodies->color == NULL || bodies->sent_pos == NULL
+			|| bodies->sent_angle == NULL || bodies->sent_vel == NULL || bodies->removed == NULL) {
+			printf("Memory allocation error: in function world_register\n");
+			exit(-1);
+		}
+
+		bodies->capacity = capacity;
+	}
+
+	// ids in between, if any, have no body
+	for (int id = bodies->count; id < body_id; id++) {
+		bodies->body[id] = NULL;
+		bodies->removed[id] = false;
+	}
+
+	if (body_id >= bodies->count)
+		bodies->count = body_id + 1;
+
+	bodies->body[body_id] = body;
+	bodies->color[body_id] = color;
+	bodies->sent_pos[body_id] = cpv(INFINITY, INFINITY);
+	bodies->sent_angle[body_id] = INFINITY;
+	bodies->sent_vel[body_id] = cpvzero;
+	bodies->removed[body_id] = false;
+}
+
+/*
+	Takes a body and its shapes out of the space and the
+	registry, marking it removed until the clients are
+	told.  Their memory stays in the arena.
+
+	Parameters:
+		*world = world the body belongs to
+		body_id = id of the body
+ */
+static void
+world_remove_body (world_status *world, int body_id) {
+
+	cpBody *body = world->bodies.body[body_id];
+
+	cpBodyEachShape (body, world_remove_shape, world->space);
+
+	// rogue bodies were never added to the space
+	if (!cpBodyIsRogue (body))
+		cpSpaceRemoveBody (world->space, body);
+
+	world->bodies.body[body_id] = NULL;
+	world->bodies.removed[body_id] = true;
+}
+
+/*
+	Removes a shape from the space.  Its memory belongs to
+	the arena; destroying it frees what Chipmunk allocated
+	for it (the vertices of polygons).
+
+	Parameters:
+		*body = body the shape is attached to
+		*shape = shape to remove
+		*data = the cpSpace
+ */
+static void
+world_remove_shape (cpBody *body, cpShape *shape, void *data) {
+
+	cpSpaceRemoveShape ((cpSpace *)data, shape);
+	cpShapeDestroy (shape);
+}
+
+/*
+	Writes the state of every body of the world, and what it
+	takes to draw the player bodies again, into a buffer.
+
+	Parameters:
+		*world = world to save
+		*buffer = where to write the snapshot
+		size = bytes available in buffer
+
+	Returns: bytes the snapshot takes; nothing was written if
+	that is more than size
+ */
+size_t
+world_snapshot (world_status *world, void *buffer, size_t size) {
+
+	int body_count = world->bodies.count;
+	int player_count = 0;
+	size_t needed = sizeof(snapshot_header) + body_count * sizeof(snapshot_body);
+
+	for (int id = world->level_body_count; id < body_count; id++) {
+
+		cpBody *body = world->bodies.body[id];
+		if (body == NULL)
+			continue;
+
+		body_information *info = (body_information *)cpBodyGetUserData (body);
+		needed += sizeof(snapshot_player) + info->outline_count * sizeof(cpVect);
+		player_count++;
+	}
+
+	if (needed > size)
+		return needed;
+
+	char *bytes = (char *)buffer;
+
+	snapshot_header header;
+	header.level = world->level;
+	header.body_count = body_count;
+	header.next_id = world->body_count;
+	header.status = world->status;
+	header.settled = world->settled;
+	header.player_count = player_count;
+	header.rest_time = world->rest_time;
+	header.max_speed = world->max_speed;
+
+	memcpy (bytes, &header, sizeof header);
+	bytes += sizeof header;
+
+	for (int id = 0; id < body_count; id++) {
+
+		cpBody *body = world->bodies.body[id];
+		snapshot_body record;
+		memset (&record, 0, sizeof record);
+
+		if (body != NULL) {
+
+			record.flags = SNAPSHOT_PRESENT;
+			if (cpBodyIsSleeping (body))
+				record.flags |= SNAPSHOT_SLEEPING;
+
+			record.pos = cpBodyGetPos (body);
+			record.vel = cpBodyGetVel (body);
+			record.angle = cpBodyGetAngle (body);
+			record.angular_velocity = cpBodyGetAngVel (body);
+		}
+
+		memcpy (bytes, &record, sizeof record);
+		bytes += sizeof record;
+	}
+
+	for (int id = world->level_body_count; id < body_count; id++) {
+
+		cpBody *body = world->bodies.body[id];
+		if (body == NULL)
+			continue;
+
+		body_information *info = (body_information *)cpBodyGetUserData (body);
+
+		// every shape of a drawn body has the same friction and type
+		cpShape *shape = NULL;
+		cpBodyEachShape (body, world_first_shape, &shape);
+
+		snapshot_player player;
+		player.body_id = id;
+		player.color = world->bodies.color[id];
+		player.collision = cpShapeGetCollisionType (shape);
+		player.outline_count = info->outline_count;
+		player.mass = cpBodyGetMass (body);
+		player.mu = cpShapeGetFriction (shape);
+
+		memcpy (bytes, &player, sizeof player);
+		bytes += sizeof player;
+
+		memcpy (bytes, info->outline, info->outline_count * sizeof(cpVect));
+		bytes += info->outline_count * sizeof(cpVect);
+	}
+
+	return needed;
+}
+
+/*
+	Puts a world back in the state saved by world_snapshot.
+	When the world has the same bodies as the snapshot only
+	their states are written; otherwise the world is reset
+	and the player bodies of the snapshot drawn again first.
+
+	Parameters:
+		*world = world to restore, of the level of the snapshot
+		*buffer = the snapshot
+		size = its length
+
+	Returns: false, leaving the world as it was, if the
+	snapshot is of another level or is cut short
+ */
+bool
+world_restore (world_status *world, const void *buffer, size_t size) {
+
+	const char *bytes = (const char *)buffer;
+	snapshot_header header;
+
+	if (size < sizeof header)
+		return false;
+
+	memcpy (&header, bytes, sizeof header);
+
+	const char *records = bytes + sizeof header;
+	size_t records_size = (size_t)header.body_count * sizeof(snapshot_body);
+
+	if (header.level != world->level || header.body_count < world->level_body_count
+		|| size - sizeof header < records_size)
+		return false;
+
+	if (!world_snapshot_matches (world, records, header.body_count)) {
+
+		const char *players = records + records_size;
+
+		if (!world_snapshot_players_fit (players, size - sizeof header - records_size, header.player_count))
+			return false;
+
+		world_reset (world);
+
+		// level bodies that had left the bounds when the snapshot was taken
+		for (int id = 0; id < world->level_body_count; id++) {
+
+			snapshot_body record;
+			memcpy (&record, records + id * sizeof record, sizeof record);
+
+			if (!(record.flags & SNAPSHOT_PRESENT) && world->bodies.body[id] != NULL)
+				world_remove_body (world, id);
+		}
+
+		world_restore_players (world, players, header.player_count);
+	}
+
+	// ids past the registry had no body restored for them, and are absent
+	for (int id = 0; id < header.body_count && id < world->bodies.count; id++) {
+
+		cpBody *body = world->bodies.body[id];
+
+		if (body == NULL || cpBodyIsStatic (body))
+			continue;
+
+		snapshot_body record;
+		memcpy (&record, records + id * sizeof record, sizeof record);
+
+		// the setters wake the body up
+		cpBodySetPos (body, record.pos);
+		cpBodySetVel (body, record.vel);
+		cpBodySetAngle (body, record.angle);
+		cpBodySetAngVel (body, record.angular_velocity);
+		cpBodyResetForces (body);
+		cpSpaceReindexShapesForBody (world->space, body);
+
+		// each body goes back to sleep on its own; bodies that slept
+		// together wake up one by one when something touches them
+		if ((record.flags & SNAPSHOT_SLEEPING) && !cpBodyIsRogue (body))
+			cpBodySleep (body);
+	}
+
+	world->body_count = header.next_id;
+	world->status = header.status;
+	world->settled = header.settled;
+	world->rest_time = header.rest_time;
+	world->max_speed = header.max_speed;
+
+	return true;
+}
+
+/*
+	Tells whether the world has a body for exactly the ids
+	that had one in a snapshot, so that restoring it only
+	has to set their states.
+
+	Parameters:
+		*world = world to restore
+		*records = the snapshot_body records of the snapshot
+		body_count = number of records
+
+	Returns: true if the bodies match
+ */
+static bool
+world_snapshot_matches (world_status *world, const char *records, int body_count) {
+
+	if (world->bodies.count != body_count)
+		return false;
+
+	for (int id = 0; id < body_count; id++) {
+
+		snapshot_body record;
+		memcpy (&record, records + id * sizeof record, sizeof record);
+
+		if ((world->bodies.body[id] != NULL) != ((record.flags & SNAPSHOT_PRESENT) != 0))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+	Checks that the player records of a snapshot, outlines
+	included, are all within the buffer.
+
+	Parameters:
+		*players = first player record
+		size = bytes left in the buffer
+		player_count = number of records
+
+	Returns: true if they fit
+ */
+static bool
+world_snapshot_players_fit (const char *players, size_t size, int player_count) {
+
+	for (int i = 0; i < player_count; i++) {
+
+		snapshot_player player;
+
+		if (size < sizeof player)
+			return false;
+
+		memcpy (&player, players, sizeof player);
+		players += sizeof player;
+		size -= sizeof player;
+
+		if (player.outline_count < 3 || size / sizeof(cpVect) < (size_t)player.outline_count)
+			return false;
+
+		players += player.outline_count * sizeof(cpVect);
+		size -= player.outline_count * sizeof(cpVect);
+	}
+
+	return true;
+}
+
+/*
+	Draws the player bodies of a snapshot again into a world
+	just reset, each with the id it had.
+
+	Parameters:
+		*world = world to add them to
+		*players = first player record
+		player_count = number of records
+ */
+static void
+world_restore_players (world_status *world, const char *players, int player_count) {
+
+	for (int i = 0; i < player_count; i++) {
+
+		snapshot_player player;
+		memcpy (&player, players, sizeof player);
+		players += sizeof player;
+
+		cpVect outline[player.outline_count];
+		memcpy (outline, players, sizeof outline);
+		players += sizeof outline;
+
+		// the outline is around the body position, so the body is built
+		// near the origin and then moved with the other states
+		world->body_count = player.body_id;
+		create_user_object (outline, player.outline_count, (COLOR)player.color, world,
+			player.collision, player.mu, player.mass);
+	}
+}
+
+/*
+	cpBodyEachShape callback keeping the first shape of a
+	body.
+
+	Parameters:
+		*body = body the shape belongs to
+		*shape = the shape
+		*data = cpShape ** to store it in, if still NULL
+ */
+static void
+world_first_shape (cpBody *body, cpShape *shape, void *data) {
+
+	cpShape **first = (cpShape **)data;
+
+	if (*first == NULL)
+		*first = shape;
+}
+
+/*
+	Loads every level from level1 up to the first one
+	that is missing, so that no level switch has to
+	read a file later, and turns on the collisions
+	between segments that the levels are built from.
+
+	Returns: number of levels loaded
+ */
+int
+world_load_levels (void) {
+
+	// a global setting of Chipmunk, set here once before any world is
+	// stepped rather than by every world_new, which may run on any thread
+	cpEnableSegmentToSegmentCollisions(); //muy importante
+
+	int level = 1;
+
+	while (world_template (level) != NULL)
+		level++;
+
+	return level - 1;
+}
+
+/*
+	Returns the template of a level, loading it the first
+	time it is asked for.
+
+	Parameters:
+		level = level number
+
+	Returns: the level, or NULL if it cannot be read
+ */
+static level_data *
+world_template (int level) {
+
+	if (level < 1)
+		return NULL;
+
+	if (level >= level_template_capacity) {
+
+		int capacity = (level_template_capacity > 0) ? level_template_capacity : 16;
+		while (capacity <= level)
+			capacity *= 2;
+
+		level_templates = (level_data **)realloc(level_templates, capacity * sizeof(level_data *));
+		if (level_templates == NULL) {
+			printf("Memory allocation error: in function world_template\n");
+			exit(-1);
+		}
+
+		for (int i = level_template_capacity; i < capacity; i++)
+			level_templates[i] = NULL;
+
+		level_template_capacity = capacity;
+	}
+
+	if (level_templates[level] == NULL)
+		level_templates[level] = level_load (level);
+
+	return level_templates[level];
+}
+
+/*
+	Creates a body_information struct
+
+	Parameters:
+    	*vectors = cpVectors of the shape
+		vector_size = int number of vectors
+		color = COLOR struct 
+		*world = world_status struct
+		collision = CollisionType
+		mu = cpFloat of the frictional coefficient
+		mass = cpFloat of the mass	
+
+	Returns:
+		returns the body id number
+ */
+int
+create_user_object (cpVect *vectors, int vector_size, COLOR color, world_status *world, 
+cpCollisionType collision, cpFloat mu, cpFloat mass) {
+
+	// the body sits at the centroid of its convex pieces, with their real
+	// moment; drawings that cannot be decomposed keep the old estimates
+	convex_pieces *pieces = segment_shapes ? NULL : convex_decompose (vectors, vector_size);
+
+	cpVect center = (pieces != NULL) ? pieces->centroid : center_calculation (vectors, vector_size);
+
+	cpVect vertices[vector_size];
+
+	for (int i = 0; i < vector_size; i++)
+		vertices[i] = cpvsub (vectors[i], center);
+
+	cpFloat moment = (pieces != NULL) ? convex_moment (pieces, mass, center)
+		: moment_calculation (vertices, vector_size, center, mass);
+
+	cpBody *body_new = cpSpaceAddBody(world->space, world_alloc_body (world, mass, moment));
+	cpBodySetPos(body_new, center);
+
+	body_information *info = world_body_info (world, color);
+	cpBodySetUserData(body_new, info);
+	world_register (world, info->body_id, body_new, color);
+
+	info->outline = (cpVect *)arena_alloc (world->arena, vector_size * sizeof(cpVect));
+	memcpy(info->outline, vertices, vector_size * sizeof(cpVect));
+	info->outline_count = vector_size;
+
+	// a new body starts the round again
+	world->settled = false;
+	world->rest_time = 0;
+
+	if (pieces != NULL) {
+		world_add_pieces (world, body_new, pieces, cpvneg (center), mu, collision);
+		convex_free (pieces);
+	}
+	else {
+		world_add_chain (world, body_new, vertices, vector_size, mu, collision);
+	}
+
+	return info->body_id;
+}
+
+/*
+	Builds the bodies of a level into the world, in file
+	order so that body ids match the level.
+
+	Parameters:
+		*level = level descriptors, text or compiled
+		*world = world to fill up
+ */
+static void
+world_build (level_data *level, world_status *world) {
+
+	level_header *header = level->header;
+
+	world->level_body_count = header->body_count;
+
+	if (header->drawing_box) {
+		world->drawing_box_x1 = header->drawing_box_x1;
+		world->drawing_box_y1 = header->drawing_box_y1;
+		world->drawing_box_x2 = header->drawing_box_x2;
+		world->drawing_box_y2 = header->drawing_box_y2;
+		world->drawing_box = true;
+	}
+
+	cpBB bounds = cpBBNew (world->drawing_box_x1, world->drawing_box_y1,
+		world->drawing_box_x2, world->drawing_box_y2);
+
+	for (uint32_t i = 0; i < header->body_count; i++) {
+
+		level_body *body = &level->bodies[i];
+		cpVect *vertices = level->vertices + body->vertex_offset;
+
+		if (i == 0 && !header->drawing_box)
+			bounds = body->bb;
+
+		bounds = cpBBMerge (bounds, body->bb);
+
+		if (body->shape == LEVEL_GROUND) {
+
+			body_information *info = world_body_info (world, body->color);
+
+			// the template outlives every world, so its vertices are shared
+			info->outline = vertices;
+			info->outline_count = body->vertex_count;
+
+			cpBody *ground = world->space->staticBody;
+			cpBodySetUserData (ground, info);
+			world_register (world, i, NULL, body->color);
+
+			cpShape *shape = cpSpaceAddShape (world->space, world_alloc_segment (world, ground, vertices[0], vertices[1], LINE_RADIUS));
+			cpShapeSetFriction (shape, body->mu);
+			cpShapeSetGroup (shape, SCENERY_GROUP);
+			world_track_thickness (world, 2 * LINE_RADIUS);
+
+			if (segment_shapes) {
+				shape = cpSpaceAddShape (world->space, world_alloc_segment (world, ground, vertices[1], vertices[0], LINE_RADIUS));
+				cpShapeSetFriction (shape, body->mu);
+				cpShapeSetGroup (shape, SCENERY_GROUP);
+			}
+			continue;
+		}
+
+		world_build_body (world, level, i);
+	}
+
+	world->bounds = cpBBNew (bounds.l - BOUNDS_MARGIN, bounds.b - BOUNDS_MARGIN,
+		bounds.r + BOUNDS_MARGIN, INFINITY);
+}
+
+/*
+	Builds one level body other than the ground, in its
+	initial pose, and puts it in the level bodies of the
+	world.
+
+	Parameters:
+		*world = world to add the body to
+		*level = level descriptors
+		index = body id of the body in the level
+ */
+static void
+world_build_body (world_status *world, level_data *level, uint32_t index) {
+
+	level_body *body = &level->bodies[index];
+	cpVect *vertices = level->vertices + body->vertex_offset;
+
+	body_information *info = world_body_info (world, body->color);
+
+	// the template outlives every world, so its vertices are shared
+	info->body_id = index;
+	info->outline = vertices;
+	info->outline_count = body->vertex_count;
+
+	cpBody *body_new;
+
+	// static and kinematic bodies stay rogue, out of the space's body
+	// list, so they are neither integrated nor sent in snapshots
+	if (body->mode == LEVEL_STATIC) {
+		body_new = world_alloc_static_body (world);
+	}
+	else if (body->mode == LEVEL_KINEMATIC) {
+		body_new = world_alloc_body (world, INFINITY, INFINITY);
+		cpBodySetVel(body_new, body->velocity);
+		cpBodySetAngVel(body_new, body->angular_velocity);
+	}
+	else {
+		body_new = cpSpaceAddBody(world->space, world_alloc_body (world, body->mass, body->moment));
+	}
+
+	cpBodySetPos(body_new, body->center);
+	cpBodySetUserData(body_new, info);
+	world_register (world, index, body_new, body->color);
+
+	world_add_shapes (world, body_new, body->shape, vertices, body->vertex_count, body->mu, body->collision);
+
+	if (body->mode != LEVEL_DYNAMIC)
+		cpBodyEachShape (body_new, world_set_scenery, NULL);
+}
+
+/*
+	Picks the spatial index of a newly built world: the
+	spatial hash if the level asks for it, or if it did not
+	ask for anything and has many shapes of similar size,
+	and Chipmunk's default bounding box tree otherwise.
+
+	Parameters:
+		*world = world whose level was just built
+		*header = level header with the index settings
+ */
+static void
+world_choose_index (world_status *world, level_header *header) {
+
+	level_index index = (forced_index != LEVEL_INDEX_AUTO) ? forced_index : (level_index)header->index;
+
+	shape_sizes sizes;
+	sizes.count = 0;
+	sizes.total_size = 0;
+	sizes.max_size = 0;
+
+	cpSpaceEachShape (world->space, world_measure_shape, &sizes);
+
+	cpFloat mean_size = (sizes.count > 0) ? sizes.total_size / sizes.count : 1;
+
+	if (index == LEVEL_INDEX_AUTO)
+		index = (sizes.count >= HASH_MIN_SHAPES && sizes.max_size <= HASH_SIZE_SPREAD * mean_size)
+			? LEVEL_INDEX_HASH : LEVEL_INDEX_TREE;
+
+	world->spatial_hash = (index == LEVEL_INDEX_HASH);
+
+	if (!world->spatial_hash)
+		return;
+
+	cpFloat dim = (header->index_dim > 0) ? header->index_dim : mean_size;
+	int count = (header->index_count > 0) ? (int)header->index_count
+		: HASH_CELLS_PER_SHAPE * (sizes.count + HASH_PLAYER_SHAPES);
+
+	cpSpaceUseSpatialHash (world->space, dim, count);
+}
+
+/*
+	Adds the size of a shape, the larger side of its
+	bounding box, to the statistics.
+
+	Parameters:
+		*shape = shape of the space
+		*data = shape_sizes to update
+ */
+static void
+world_measure_shape (cpShape *shape, void *data) {
+
+	shape_sizes *sizes = (shape_sizes *)data;
+	cpBB bb = cpShapeGetBB (shape);
+	cpFloat size = cpfmax (bb.r - bb.l, bb.t - bb.b);
+
+	sizes->count++;
+	sizes->total_size += size;
+	sizes->max_size = cpfmax (sizes->max_size, size);
+}
+
+/*
+	Chooses the spatial index of later worlds regardless of
+	what their levels ask for.
+
+	Parameters:
+		index = level_index to use, LEVEL_INDEX_AUTO to
+			let each level decide again
+ */
+void
+world_use_spatial_index (int index) {
+
+	forced_index = (level_index)index;
+}
+
+/*
+	Puts a shape of a body that cannot move into the
+	scenery group.
+
+	Parameters:
+		*body = body of the shape
+		*shape = shape to change
+		*data = unused
+ */
+static void
+world_set_scenery (cpBody *body, cpShape *shape, void *data) {
+
+	cpShapeSetGroup (shape, SCENERY_GROUP);
+}
+
+/*
+	Builds the collision shapes of a body: one segment for
+	a line, a box shape for a box, convex polygons for any
+	other simple outline, and a closed chain of segments
+	for outlines that cross themselves.
+
+	Parameters:
+		*world = world status with the space
+		*body = body to attach to
+		shape = kind of body
+		*vertices = outline relative to the body
+		vertex_count = number of vertices
+		mu = friction of the shapes
+		collision = collision type of the shapes
+ */
+static void
+world_add_shapes (world_status *world, cpBody *body, level_shape shape, cpVect *vertices, int vertex_count, cpFloat mu, cpCollisionType collision) {
+
+	convex_pieces *pieces;
+	cpShape *added;
+
+	if (shape == LEVEL_LINE) {
+
+		added = world_alloc_segment (world, body, vertices[0], vertices[1], LINE_RADIUS);
+		world_track_thickness (world, 2 * LINE_RADIUS);
+
+		if (segment_shapes) {
+			cpShape *line = cpSpaceAddShape (world->space, world_alloc_segment (world, body, vertices[1], vertices[0], LINE_RADIUS));
+			cpShapeSetFriction (line, mu);
+			cpShapeSetCollisionType (line, collision);
+		}
+	}
+	else if (segment_shapes) {
+		world_add_chain (world, body, vertices, vertex_count, mu, collision);
+		return;
+	}
+	else if (shape == LEVEL_BOX) {
+		// box corners are (+-width/2, +-height/2); level heights may be negative
+		added = world_alloc_box (world, body, cpfabs (2 * vertices[0].x), cpfabs (2 * vertices[0].y));
+		world_track_thickness (world, 2 * cpfmin (cpfabs (vertices[0].x), cpfabs (vertices[0].y)));
+	}
+	else if ((pieces = convex_decompose (vertices, vertex_count)) != NULL) {
+		world_add_pieces (world, body, pieces, cpvzero, mu, collision);
+		convex_free (pieces);
+		return;
+	}
+	else {
+		world_add_chain (world, body, vertices, vertex_count, mu, collision);
+		return;
+	}
 
-//Prototypes for testing functions
-static cpVect center_calculation (cpVect *vectors, int vector_size);
-static cpFloat moment_calculation (cpVect *vectors, int vector_size, cpVect center, cpFloat mass);
-static void world_zone_read (FILE *ifile, world_status *world);
+	cpSpaceAddShape (world->space, added);
+	cpShapeSetFriction (added, mu);
+	cpShapeSetCollisionType (added, collision);
+}
 
 /*
-	returns the ground from the cpSpace.
+	Attaches one polygon shape per convex piece to a body
 
 	Parameters:
-		*space = cpSpace
+		*world = world status with the space
+		*body = body to attach to
+		*pieces = decomposed outline
+		offset = added to every vertex to make it body relative
+		mu = friction of the shapes
+		collision = collision type of the shapes
+ */
+static void
+world_add_pieces (world_status *world, cpBody *body, convex_pieces *pieces, cpVect offset, cpFloat mu, cpCollisionType collision) {
 
-	Returns:
-		cpBody of the ground
+	for (int i = 0; i < pieces->piece_count; i++) {
+
+		cpShape *piece = cpSpaceAddShape (world->space, world_alloc_poly (world, body, pieces->sizes[i],
+			pieces->vertices + pieces->offsets[i], offset));
+
+		cpShapeSetFriction (piece, mu);
+		cpShapeSetCollisionType (piece, collision);
+
+		cpBB bb = cpShapeGetBB (piece);
+		world_track_thickness (world, cpfmin (bb.r - bb.l, bb.t - bb.b));
+	}
+}
+
+/*
+	Chooses between native shapes and the segment outlines
+	bodies were built from before.
+
+	Parameters:
+		enabled = true to build worlds from segments only
  */
-cpBody *world_get_ground (cpSpace *space) {
-	return space->staticBody;
+void
+world_use_segment_shapes (bool enabled) {
+
+	segment_shapes = enabled;
 }
 
 /*
-	Checks for whether there is a collision between the target and the players's
-	boxes.
+	Creates the body_information of the next body id
 
 	Parameters:
-    	*arbiter = cpArbiter that detects collision with targets
-    	*space = the cpSpace that simulates the game
-    	*world = world_status that represents the status of the game
+		*world = world status whose body count is used
+		color = color of the body
 
-	Returns:
-    	cpBool that represents whether the function has finished handling the
-     	collision
+	Returns: the new body information
  */
-static cpBool
-target_collision (cpArbiter *arbiter, cpSpace *space, void *data) {
+static body_information *
+world_body_info (world_status *world, COLOR color) {
 
-	world_status *world = (world_status *)data;
-	world->status = 1;
+	body_information *info = (body_information *)arena_alloc (world->arena, sizeof(body_information));
 
-	return true;
-}
+	info->color = color;
+	info->body_id = world->body_count;
+	info->outline = NULL;
+	info->outline_count = 0;
+	world->body_count++;
 
+	return info;
+}
 
 /*
-	Creates a new world_status
+	Creates a body in the arena of the world
 
 	Parameters:
-    	level = int representing the level the user has chosen
-    	timestep = the amount of time to step the world
+		*world = world that owns the body
+		mass = mass of the body
+		moment = moment of inertia of the body
 
-	Returns:
-		a new world_status
+	Returns: the body, not added to the space
  */
-world_status
-*world_new(int level, float timestep) {
+static cpBody *
+world_alloc_body (world_status *world, cpFloat mass, cpFloat moment) {
 
-	world_status *world= malloc(sizeof(world_status));
-	if (world == NULL) {
-		printf("Memeory allocation error in function world_new\n");
-		exit(-1);
-	}
+	return cpBodyInit ((cpBody *)arena_alloc (world->arena, sizeof(cpBody)), mass, moment);
+}
 
-	world->status = 2;
-	world->drawing_box_x1 = world->drawing_box_y1 = 0;
-	world->drawing_box_x2 = world->drawing_box_y2 = 0;
-	world->drawing_box = false;
-	world->timestep = timestep;
-	world->body_count = 0;
-	world->space = cpSpaceNew();
-	cpEnableSegmentToSegmentCollisions(); //muy importante
+/*
+	Creates a rogue static body in the arena of the world
 
-	char filename[40];
+	Parameters:
+		*world = world that owns the body
 
-	sprintf( filename, "level%i.lvl", level );
+	Returns: the body
+ */
+static cpBody *
+world_alloc_static_body (world_status *world) {
 
-	FILE *ifile;
+	return cpBodyInitStatic ((cpBody *)arena_alloc (world->arena, sizeof(cpBody)));
+}
 
-	if ((ifile = fopen (filename, "r")) == NULL)
-		exit(-1);
-	
-	cpSpaceSetGravity (world->space, cpv(0, -75)); //Set gravity
+/*
+	Creates a segment shape in the arena of the world, like
+	cpSegmentShapeNew
 
-	world_level_read (ifile, world);
+	Returns: the shape, not added to the space
+ */
+static cpShape *
+world_alloc_segment (world_status *world, cpBody *body, cpVect a, cpVect b, cpFloat radius) {
 
-	cpSpaceAddCollisionHandler (world->space, TARGET_COLLISION_NUMBER,
-				    PLAYER_BOX_COLLISION_NUMBER,
-				    target_collision, NULL, NULL, NULL, world);
+	cpSegmentShape *segment = (cpSegmentShape *)arena_alloc (world->arena, sizeof(cpSegmentShape));
 
-	return world;
+	return (cpShape *)cpSegmentShapeInit (segment, body, a, b, radius);
 }
 
 /*
-	Creates a body_information struct
+	Creates a convex polygon shape in the arena of the
+	world, like cpPolyShapeNew.  Chipmunk still mallocs a
+	copy of the vertices, which cpShapeDestroy frees.
 
-	Parameters:
-    	*vectors = cpVectors of the shape
-		vector_size = int number of vectors
-		color = COLOR struct 
-		*world = world_status struct
-		collision = CollisionType
-		mu = cpFloat of the frictional coefficient
-		mass = cpFloat of the mass	
+	Returns: the shape, not added to the space
+ */
+static cpShape *
+world_alloc_poly (world_status *world, cpBody *body, int count, cpVect *vertices, cpVect offset) {
 
-	Returns:
-		returns the body id number
+	cpPolyShape *poly = (cpPolyShape *)arena_alloc (world->arena, sizeof(cpPolyShape));
+
+	return (cpShape *)cpPolyShapeInit (poly, body, count, vertices, offset);
+}
+
+/*
+	Creates a box shape in the arena of the world, like
+	cpBoxShapeNew
+
+	Returns: the shape, not added to the space
  */
-int
-create_user_object (cpVect *vectors, int vector_size, COLOR color, world_status *world, 
-cpCollisionType collision, cpFloat mu, cpFloat mass) {
+static cpShape *
+world_alloc_box (world_status *world, cpBody *body, cpFloat width, cpFloat height) {
 
-	cpVect center = center_calculation (vectors, vector_size);
+	cpPolyShape *box = (cpPolyShape *)arena_alloc (world->arena, sizeof(cpPolyShape));
 
-	cpVect vertices[vector_size];
+	return (cpShape *)cpBoxShapeInit (box, body, width, height);
+}
 
-	for (int i = 0; i < vector_size; i++)
-		vertices[i] = cpvsub (vectors[i], center);
+/*
+	Frees what Chipmunk allocated inside a shape, leaving
+	the shape itself to the arena.
 
-	cpFloat moment = moment_calculation (vertices, vector_size, center, mass);
+	Parameters:
+		*shape = shape of the space
+		*data = unused
+ */
+static void
+world_destroy_shape (cpShape *shape, void *data) {
 
-	cpBody *body_new = cpSpaceAddBody(world->space, cpBodyNew(mass, moment));
-	cpBodySetPos(body_new, center);
-	body_information *info = (body_information *)malloc(sizeof(body_information));
-	if (info == NULL) {
-		printf("Memory allocation error: in function create_user_object\n");
-		exit(-1);
-	}
+	cpShapeDestroy (shape);
+}
 
-	info->color = color;
-	info->body_id = world->body_count;
-	world->body_count++;
-	cpBodySetUserData(body_new, info);
+/*
+	Attaches a closed chain of segments through the
+	vertices to a body
+
+	Parameters:
+		*world = world status with the space
+		*body = body to attach to
+		*vertices = outline relative to the body
+		vertex_count = number of vertices
+		mu = friction of the segments
+		collision = collision type of the segments
+ */
+static void
+world_add_chain (world_status *world, cpBody *body, cpVect *vertices, int vertex_count, cpFloat mu, cpCollisionType collision) {
 
-	cpShape *line = cpSpaceAddShape (world->space, cpSegmentShapeNew (body_new, vertices[vector_size - 1], vertices[0], LINE_RADIUS));
+	cpShape *line = cpSpaceAddShape (world->space, world_alloc_segment (world, body, vertices[vertex_count - 1], vertices[0], LINE_RADIUS));
 	cpShapeSetFriction(line, mu);
 	cpShapeSetCollisionType (line, collision);
+	world_track_thickness (world, 2 * LINE_RADIUS);
 
-	for (int i = vector_size - 2; i >= 0; i--) {
-		cpShape *line = cpSpaceAddShape(world->space, cpSegmentShapeNew(body_new, vertices[i], vertices[i + 1], LINE_RADIUS));
+	for (int i = vertex_count - 2; i >= 0; i--) {
+		cpShape *line = cpSpaceAddShape(world->space, world_alloc_segment (world, body, vertices[i], vertices[i + 1], LINE_RADIUS));
 		cpShapeSetFriction(line, mu);
 		cpShapeSetCollisionType (line, collision);
 	}
-
-	return info->body_id;
 }
 
 /*
@@ -179,7 +1327,7 @@ cpCollisionType collision, cpFloat mu, cpFloat mass) {
 	Returns:
 		returns the center of the shape
  */
-static cpVect
+cpVect
 center_calculation (cpVect *vectors, int vector_size) {
 
 	cpVect average = cpv(0,0);
@@ -207,7 +1355,7 @@ center_calculation (cpVect *vectors, int vector_size) {
 	Returns:
 		float of the moment
  */
-static cpFloat
+cpFloat
 moment_calculation (cpVect *vectors, int vector_size, cpVect center, cpFloat mass) {
 
 	cpFloat radius = 0;
@@ -221,291 +1369,193 @@ moment_calculation (cpVect *vectors, int vector_size, cpVect center, cpFloat mas
 }
 
 /*
-	Reads the level from the file.
+	
+	updates the world
 
 	Parameters:
-    	*ifile = FILE to read level from
-    	*world = pointer to the world_status to fill up
- */
-static void
-world_level_read (FILE *ifile, world_status *world) {
-	char input[100];
-	int collision_type = OBSTACLE_COLLISION_NUMBER;
-
-	while (fscanf(ifile, "%s", input) != EOF) {
-
-		if (strcmp (input, "TARGET") == 0) {
-			collision_type = TARGET_COLLISION_NUMBER;
-		}
-		else if (strcmp (input, "OBSTACLE") == 0) {
-			collision_type = OBSTACLE_COLLISION_NUMBER;
-		}
-		else if (strcmp (input, "GROUND") == 0) {
-			world_ground_read (ifile, world);
-		}
-		else if (strcmp (input, "CUSTOM") == 0) {
-			world_custom_read (ifile, world, collision_type);
-		}
-		else if (strcmp (input, "BOX") == 0) {
-			world_box_read (ifile, world, collision_type);
-		}
-		else if (strcmp (input, "LINE") == 0) {
-			world_line_read (ifile, world, collision_type);
-		}
-		else if (strcmp (input, "ZONE") == 0) {
-			world_zone_read (ifile, world);
-		}
-	}
-}
-
-/*
-	Reads the zone from the file.
+		*world = world status struct pointer to be updated
 
-	Parameters:
-    	*ifile = FILE to read level from
-    	*world = pointer to the world_status to fill up
+	Returns:
+		world update struct
  */
-static void
-world_zone_read (FILE *ifile, world_status *world) {
-
-	float x1, y1, x2, y2;
-	fscanf(ifile, "%f%f%f%f", &x1, &y1, &x2, &y2);
+void
+*world_update (world_status *world) {
 
-	world->drawing_box_x1 = x1;
-    world->drawing_box_y1 = y1;
-    world->drawing_box_x2 = x2;
-    world->drawing_box_y2 = y2;
+	if (world->settled)
+		return world;
 
-	world->drawing_box = true;
+	level_data *level = world_template (world->level);
 
-}
+	bool moving = false;
+	cpFloat kinematic_speed = 0;
 
+	for (int i = 0; i < world->level_body_count; i++) {
 
-/*
-	reads a custom body from the .lvl file
+		if (level->bodies[i].mode != LEVEL_KINEMATIC)
+			continue;
 
-	Parameters:
-		*ifile = file pointer to the level
-		*world = world status to be updated
-		collision = type of collision
- */
-static void
-world_custom_read (FILE *ifile, world_status *world, cpCollisionType collision) {
+		kinematic_speed = cpfmax (kinematic_speed, cpvlength (level->bodies[i].velocity));
 
-	char input[10], input2[10];
-	cpVect *vectors = (cpVect *)malloc(sizeof(cpVect));
-	if (vectors == NULL) {
-		printf("Memeory allocation error in function world_custom_read\n");
-		exit(-1);
+		// a level with moving scenery never settles
+		if (!cpveql (level->bodies[i].velocity, cpvzero) || level->bodies[i].angular_velocity != 0)
+			moving = true;
 	}
 
-	int capacity = 1;
-	int size = 0;
-	strcpy(input, "1");
-	strcpy(input2, "1");
+	int substeps = world_substeps (world, kinematic_speed);
+	cpFloat dt = world->timestep / substeps;
+	double step_time = 0;
 
-	while (strcmp(input, "z") != 0) {
-
-		fscanf(ifile, "%s%s", input, input2);
-
-		if (strcmp(input, "z") != 0) {
-			size++;
-			if (size == capacity) {
-				capacity *= 2;
-				vectors = (cpVect *)realloc(vectors, capacity * sizeof(cpVect));
-				if (vectors == NULL) {
-					printf("Memory allocation error: in function world_custom_read\n");
-					exit(-1);
-				}
-			}
-			int x = atoi(input);
-			int y = atoi(input2);
-			vectors[size-1] = cpv( x, y );
-		}
-	}
+	for (int step = 0; step < substeps; step++) {
 
-	char color[10];
-	fscanf( ifile, "%s", color );
+		// kinematic bodies are rogue, so the space does not move them; like
+		// the space does for its own bodies, move them before solving
+		for (int i = 0; i < world->level_body_count; i++)
+			if (level->bodies[i].mode == LEVEL_KINEMATIC)
+				cpBodyUpdatePosition (world->bodies.body[i], dt);
 
-	float mu, mass;
-	fscanf( ifile, "%f%f", &mu, &mass );
+		double start = (world->profile != NULL) ? profile_now () : 0;
 
-	create_user_object ( vectors, size, conv_color(color), world, collision, mu, mass );
-}
+		cpSpaceStep (world->space, dt);
 
-/*
-	reads the drawing box from the .lvl file
+		if (world->profile != NULL)
+			step_time += profile_now () - start;
+	}
 
-	Parameters:
-		*ifile = file pointer to the level
-		*world = world status to be updated
-		collision = type of collision
- */
-static void
-world_box_read ( FILE *ifile, world_status *world, cpCollisionType collision ) {
+	// at rest means under the speed Chipmunk uses to put bodies to sleep
+	cpFloat idle_speed = cpSpaceGetIdleSpeedThreshold (world->space);
+	cpFloat rest_speed_sq = (idle_speed > 0) ? idle_speed * idle_speed
+		: cpvlengthsq (cpSpaceGetGravity (world->space)) * world->timestep * world->timestep;
 
-	float x1, y1, width, height;
-	fscanf( ifile, "%f%f%f%f", &x1, &y1, &width, &height );
+	cpFloat max_speed = 0;
+	int sleeping = 0, removed = 0;
 
-	cpVect center = cpv( x1, y1 );
+	// the space is unlocked again, so bodies out of bounds can go right away
+	for (int id = 0; id < world->bodies.count; id++) {
 
-	char color[10];
-	fscanf( ifile, "%s", color );
+		cpBody *body = world->bodies.body[id];
 
-	float mu, mass;
-	fscanf( ifile, "%f%f", &mu, &mass );
+		// the ground, removed bodies and the static and kinematic scenery
+		if (body == NULL || cpBodyIsRogue (body))
+			continue;
 
-	body_information *info = (body_information *) malloc( sizeof( body_information ) );
-	if (info == NULL) {
-		printf("Memory allocation error: in function world_box_read\n");
-		exit(-1);
-	}
+		if (!cpBBContainsVect (world->bounds, cpBodyGetPos (body))) {
+			world_remove_body (world, id);
+			removed++;
+			continue;
+		}
 
-	info->color = conv_color ( color );
-	info->body_id = world->body_count;
-	world->body_count++;
+		if (cpBodyIsSleeping (body)) {
+			sleeping++;
+			continue;
+		}
 
-	cpFloat moment = cpMomentForBox(mass, width, height);
+		if (cpBodyKineticEnergy (body) >= cpBodyGetMass (body) * rest_speed_sq)
+			moving = true;
 
-	cpBody *body_new = cpSpaceAddBody(world->space, cpBodyNew(mass, moment));
-	cpBodySetPos(body_new, center);
-	cpBodySetUserData(body_new, info);
+		max_speed = cpfmax (max_speed, cpvlength (cpBodyGetVel (body)));
+	}
 
-	cpVect corners[4] = { cpv(width/2, height/2), cpv(width/2, -height/2),
-						cpv(-width/2, -height/2), cpv(-width/2, height/2)};
+	world->max_speed = max_speed;
+	world->rest_time = moving ? 0 : world->rest_time + world->timestep;
 
-	cpShape *line = cpSpaceAddShape (world->space, cpSegmentShapeNew (body_new, corners[3], corners[0], LINE_RADIUS));
-	cpShapeSetFriction(line, mu);
-	cpShapeSetCollisionType (line, collision);
+	if (world->rest_time >= world->settle_time)
+		world->settled = true;
 
-	for (int i = 2; i >= 0; i--) {
-		cpShape *line = cpSpaceAddShape( world->space, cpSegmentShapeNew( body_new, corners[i], corners[i + 1], LINE_RADIUS ));
-		cpShapeSetFriction( line, mu );
-		cpShapeSetCollisionType ( line, collision );
+	if (world->profile != NULL) {
+		world->sample.level = world->level;
+		world->sample.step_time = step_time;
+		world->sample.sleeping_bodies = sleeping;
+		world->sample.post_step = removed;
 	}
+
+	return world;
 }
 
 /*
-	reads a line body from the .lvl file
+	Sets the ring a world is profiled into.  Without
+	sleeping the space only links the contact pairs to the
+	bodies, which profile_space_counts counts them through,
+	with the contact graph enabled.
 
 	Parameters:
-		*ifile = file pointer to the level
-		*world = world status to be updated
-		collision = type of collision
+		*world = world to profile
+		*ring = ring of the profiler, NULL to stop
  */
-static void
-world_line_read ( FILE *ifile, world_status *world, cpCollisionType collision ) {
-
-	float x1, y1, x2, y2;
-	fscanf( ifile, "%f%f%f%f", &x1, &y1, &x2, &y2 );
-	cpVect center = cpv((x1 + x2) / 2, (y1 + y2) / 2);
-
-	//These two vects (a and b) are relative to center
-	cpVect vectA = cpv(x1 - center.x, y1 - center.y);
-	cpVect vectB = cpv(x2 - center.x, y2 - center.y);
-
-	char color[10];
-	fscanf(ifile, "%s", color);
-
-	float mu;
-	fscanf(ifile, "%f", &mu);
-
-	float mass;
-	fscanf(ifile, "%f", &mass);
-
-	body_information *info = (body_information *)malloc(sizeof(body_information));
-	if (info == NULL) {
-		printf("Memory allocation error: in function world_line_read\n");
-		exit(-1);
-	}
+void
+world_set_profile (world_status *world, profile_ring *ring) {
 
-	info->color = conv_color (color);
-	info->body_id = world->body_count;
-	world->body_count++;
+	world->profile = ring;
 
-	// The moment of inertia
-  	cpFloat moment = cpMomentForSegment(mass, vectA, vectB);
+	if (ring != NULL)
+		cpSpaceSetEnableContactGraph (world->space, cpTrue);
+}
 
-  	// The cpSpaceAdd*() functions return the thing that you are adding.
-  	// It's convenient to create and add an object in one line.
-  	cpBody *body_new = cpSpaceAddBody(world->space, cpBodyNew(mass, moment));
-	cpBodySetPos(body_new, center);
-	cpBodySetUserData(body_new, info);
+/*
+	Pushes the sample of the last update of a profiled
+	world, with its awake bodies and contact pairs counted
+	now.
 
-	// Now we create the collision shape for the ball.
- 	// You can create multiple collision shapes that point to the same body.
-	// They will all be attached to the body and move around to follow it.
-	cpShape *line = cpSpaceAddShape (world->space, cpSegmentShapeNew(body_new, vectA, vectB, LINE_RADIUS));
-	cpShapeSetFriction(line, mu);
-	cpShapeSetCollisionType (line, collision);
+	Parameters:
+		*world = world to push the sample of
+ */
+void
+world_profile (world_status *world) {
 
-	line = cpSpaceAddShape (world->space, cpSegmentShapeNew(body_new, vectB, vectA, LINE_RADIUS));
-	cpShapeSetFriction(line, mu);
-	cpShapeSetCollisionType (line, collision);
+	if (world->profile == NULL)
+		return;
 
+	profile_space_counts (world->space, &world->sample.active_bodies, &world->sample.arbiters);
+	profile_push (world->profile, &world->sample);
 }
 
 /*
-  Reads the ground from the input file.
+	Keeps the thickness of the thinnest shape of the world,
+	which the step is split against.
 
-  Parameters:
-      *ifile = FILE pointer to input file
-      *world = pointer to world_status to insert target into world
+	Parameters:
+		*world = world the shape was added to
+		thickness = smallest width of the shape
  */
 static void
-world_ground_read (FILE *ifile, world_status *world) {
-	
-	char input[20];
-
-	float x1, y1, x2, y2, mu;
-
-	fscanf(ifile, "%f%f%f%f", &x1, &y1, &x2, &y2);
-
-	fscanf(ifile, "%s", input);
+world_track_thickness (world_status *world, cpFloat thickness) {
 
-	fscanf(ifile, "%f", &mu);
-
-	body_information *info = (body_information *)malloc(sizeof(body_information));
-	if (info == NULL) {
-		printf("Memory allocation error: in function world_ground_read\n");
-		exit(-1);
-	}
-
-	info->color = conv_color( input );
-	info->body_id = world->body_count;
-	world->body_count++;
-
-	cpBodySetUserData (world->space->staticBody, info);
+	if (thickness > 0 && thickness < world->min_thickness)
+		world->min_thickness = thickness;
+}
 
+/*
+	Chooses how many sub-steps the next update takes: enough
+	that the fastest body, at its speed after the last step
+	plus what gravity adds in this one, does not move more
+	than a fraction of the thinnest shape in one of them,
+	so it cannot pass through it.  Counts the choice.
 
-	cpShape *ground = cpSegmentShapeNew (world->space->staticBody,
-					     cpv(x1,y1), cpv(x2,y2), LINE_RADIUS);
+	Parameters:
+		*world = world about to be updated
+		kinematic_speed = speed of the fastest kinematic body
 
-	cpShapeSetFriction (ground, mu);
-	cpSpaceAddShape (world->space, ground);
+	Returns: number of sub-steps, 1 to WORLD_MAX_SUBSTEPS
+ */
+static int
+world_substeps (world_status *world, cpFloat kinematic_speed) {
 
-	ground = cpSegmentShapeNew (world->space->staticBody,
-					     cpv(x2,y2), cpv(x1,y1), LINE_RADIUS);
+	cpFloat speed = cpfmax (world->max_speed, kinematic_speed)
+		+ cpvlength (cpSpaceGetGravity (world->space)) * world->timestep;
 
-	cpShapeSetFriction (ground, mu);
-	cpSpaceAddShape (world->space, ground);
-}
+	int substeps = 1;
 
-/*
-	
-	updates the world
+	if (world->min_thickness < INFINITY)
+		substeps = (int)cpfceil (speed * world->timestep / (SUBSTEP_TRAVEL * world->min_thickness));
 
-	Parameters:
-		*world = world status struct pointer to be updated
+	if (substeps < 1)
+		substeps = 1;
+	else if (substeps > WORLD_MAX_SUBSTEPS)
+		substeps = WORLD_MAX_SUBSTEPS;
 
-	Returns:
-		world update struct
- */
-void
-*world_update (world_status *world) {
-	cpSpaceStep (world->space, world->timestep);
+	world->substeps = substeps;
+	world->substep_counts[substeps]++;
 
-	return world;
+	return substeps;
 }
 
 
@@ -623,9 +1673,18 @@ world_body_free(cpBody *body, cpSpace *space){
 bool
 world_free (world_status *world ){
 
-	//iterate over the objects and shapes in the space
-	world_free_space (world->space);
-
+	// bodies, shapes and their information all live in the arena; only
+	// what Chipmunk allocated itself for polygons has to go first
+	cpSpaceEachShape (world->space, world_destroy_shape, NULL);
+	cpSpaceFree (world->space);
+
+	arena_free (world->arena);
+	free (world->bodies.body);
+	free (world->bodies.color);
+	free (world->bodies.sent_pos);
+	free (world->bodies.sent_angle);
+	free (world->bodies.sent_vel);
+	free (world->bodies.removed);
 	free (world);
 
 	return true;
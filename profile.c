@@ -0,0 +1,364 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <chipmunk/chipmunk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "specs/profile.h"
+
+/*
+	profile.c
+
+	step profiler; see specs/profile.h. The ring indices
+	only ever grow and are masked when used, so head - tail
+	is the number of samples in the ring. Each side reads
+	the other's index with acquire and publishes its own
+	with release, which orders the sample copies around it.
+ */
+
+typedef struct {
+	int active_bodies;
+	int arbiters;
+} space_counts;
+
+//Prototypes for static functions
+static void profile_add (profile_histogram *histogram, double value);
+static int profile_bucket (double value);
+static double profile_bucket_top (int bucket);
+static void profile_print_histogram (FILE *file, const char *name, profile_histogram *histogram);
+static void profile_count_body (cpBody *body, void *data);
+static void profile_count_arbiter (cpBody *body, cpArbiter *arbiter, void *data);
+
+/*
+	Creates an empty profiler
+
+	Returns: the profiler
+ */
+profiler *
+profiler_new (void) {
+
+	profiler *new_profiler = (profiler *)calloc(1, sizeof(profiler));
+	if (new_profiler == NULL) {
+		printf("Memory allocation error: in function profiler_new\n");
+		exit(-1);
+	}
+
+	return new_profiler;
+}
+
+/*
+	Frees a profiler and its histograms
+
+	Parameters:
+		*profiler = profiler to free
+ */
+void
+profiler_free (profiler *profiler) {
+
+	free (profiler->levels);
+	free (profiler);
+}
+
+/*
+	Adds a sample to the ring, unless it is full
+
+	Parameters:
+		*ring = ring of the profiler
+		*sample = sample to copy in
+
+	Returns: false if the sample was dropped
+ */
+bool
+profile_push (profile_ring *ring, const profile_sample *sample) {
+
+	unsigned head = ring->head;
+	unsigned tail = __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE);
+
+	if (head - tail >= PROFILE_RING_SIZE) {
+		ring->dropped++;
+		return false;
+	}
+
+	ring->samples[head & (PROFILE_RING_SIZE - 1)] = *sample;
+	__atomic_store_n (&ring->head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/*
+	Moves the samples of the ring into the histograms
+
+	Parameters:
+		*profiler = profiler to drain
+
+	Returns: number of samples moved
+ */
+int
+profiler_drain (profiler *profiler) {
+
+	profile_ring *ring = &profiler->ring;
+	unsigned tail = ring->tail;
+	unsigned head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+	int moved = 0;
+
+	for (; tail != head; tail++, moved++) {
+
+		profile_sample *sample = &ring->samples[tail & (PROFILE_RING_SIZE - 1)];
+
+		if (sample->level < 0)
+			continue;
+
+		if (sample->level >= profiler->level_capacity) {
+
+			int capacity = (profiler->level_capacity > 0) ? profiler->level_capacity : 16;
+			while (capacity <= sample->level)
+				capacity *= 2;
+
+			profiler->levels = (profile_level *)realloc(profiler->levels, capacity * sizeof(profile_level));
+			if (profiler->levels == NULL) {
+				printf("Memory allocation error: in function profiler_drain\n");
+				exit(-1);
+			}
+
+			memset (profiler->levels + profiler->level_capacity, 0,
+				(capacity - profiler->level_capacity) * sizeof(profile_level));
+			profiler->level_capacity = capacity;
+		}
+
+		profile_level *level = &profiler->levels[sample->level];
+
+		level->steps++;
+		profile_add (&level->step_time, sample->step_time);
+		profile_add (&level->active_bodies, sample->active_bodies);
+		profile_add (&level->arbiters, sample->arbiters);
+		profile_add (&level->sleeping_bodies, sample->sleeping_bodies);
+		profile_add (&level->post_step, sample->post_step);
+	}
+
+	__atomic_store_n (&ring->tail, tail, __ATOMIC_RELEASE);
+
+	return moved;
+}
+
+/*
+	Adds a value to a histogram
+
+	Parameters:
+		*histogram = histogram to add to
+		value = value, 0 or more
+ */
+static void
+profile_add (profile_histogram *histogram, double value) {
+
+	histogram->buckets[profile_bucket (value)]++;
+	histogram->count++;
+
+	if (value > histogram->max)
+		histogram->max = value;
+}
+
+/*
+	Parameters:
+		value = value to file
+
+	Returns: the bucket value falls in
+ */
+static int
+profile_bucket (double value) {
+
+	if (value < 1)
+		return 0;
+
+	int bucket = 1 + (int)(log2 (value) * 4);
+
+	return (bucket < PROFILE_BUCKETS) ? bucket : PROFILE_BUCKETS - 1;
+}
+
+/*
+	Parameters:
+		bucket = bucket number
+
+	Returns: the value every value of the bucket is under
+ */
+static double
+profile_bucket_top (int bucket) {
+
+	return (bucket == 0) ? 1 : exp2 (bucket / 4.0);
+}
+
+/*
+	Finds a percentile of a histogram
+
+	Parameters:
+		*histogram = histogram to read
+		fraction = 0.5 for the median, 0.99 for the 99th
+			percentile
+
+	Returns: the top of the bucket the percentile is in,
+	never more than the maximum
+ */
+double
+profile_percentile (profile_histogram *histogram, double fraction) {
+
+	if (histogram->count == 0)
+		return 0;
+
+	long rank = (long)ceil (fraction * histogram->count);
+	long seen = 0;
+
+	for (int bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+
+		seen += histogram->buckets[bucket];
+
+		if (seen >= rank)
+			return fmin (profile_bucket_top (bucket), histogram->max);
+	}
+
+	return histogram->max;
+}
+
+/*
+	Prints one line of profiler_print
+
+	Parameters:
+		*file = file to print to
+		*name = name of the figure
+		*histogram = its histogram
+ */
+static void
+profile_print_histogram (FILE *file, const char *name, profile_histogram *histogram) {
+
+	fprintf (file, "  %-16s %10.1f %10.1f %10.1f\n", name, profile_percentile (histogram, 0.5),
+		profile_percentile (histogram, 0.99), histogram->max);
+}
+
+/*
+	Prints the histograms of every profiled level
+
+	Parameters:
+		*profiler = profiler to print
+		*file = file to print to
+ */
+void
+profiler_print (profiler *profiler, FILE *file) {
+
+	for (int i = 0; i < profiler->level_capacity; i++) {
+
+		profile_level *level = &profiler->levels[i];
+
+		if (level->steps == 0)
+			continue;
+
+		fprintf (file, "level %d: %ld steps\n", i, level->steps);
+		fprintf (file, "  %-16s %10s %10s %10s\n", "", "p50", "p99", "max");
+		profile_print_histogram (file, "step time (us)", &level->step_time);
+		profile_print_histogram (file, "active bodies", &level->active_bodies);
+		profile_print_histogram (file, "arbiters", &level->arbiters);
+		profile_print_histogram (file, "sleeping bodies", &level->sleeping_bodies);
+		profile_print_histogram (file, "post-step", &level->post_step);
+	}
+
+	if (profiler->ring.dropped > 0)
+		fprintf (file, "%ld samples dropped with the ring full\n", profiler->ring.dropped);
+}
+
+/*
+	Writes the histograms of every profiled level to a file
+
+	Parameters:
+		*profiler = profiler to write
+		*filename = file to replace
+
+	Returns: true if the file was written
+ */
+bool
+profiler_dump (profiler *profiler, const char *filename) {
+
+	FILE *file = fopen (filename, "w");
+	if (file == NULL)
+		return false;
+
+	profiler_print (profiler, file);
+
+	return fclose (file) == 0;
+}
+
+/*
+	Returns: the current time of the monotonic clock, in
+	microseconds
+ */
+double
+profile_now (void) {
+
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+/*
+	Counts the awake bodies and the contact pairs of a space
+	through its public iterators.  An arbiter between two
+	bodies of the space is seen from both, so it is only
+	counted from the one at the lower address.
+
+	Parameters:
+		*space = space to count
+		*active_bodies = set to the awake bodies
+		*arbiters = set to the contact pairs
+ */
+void
+profile_space_counts (cpSpace *space, int *active_bodies, int *arbiters) {
+
+	space_counts counts = { 0, 0 };
+
+	cpSpaceEachBody (space, profile_count_body, &counts);
+
+	*active_bodies = counts.active_bodies;
+	*arbiters = counts.arbiters;
+}
+
+/*
+	cpSpaceEachBody callback of profile_space_counts
+
+	Parameters:
+		*body = body of the space
+		*data = the space_counts
+ */
+static void
+profile_count_body (cpBody *body, void *data) {
+
+	space_counts *counts = (space_counts *)data;
+
+	if (cpBodyIsSleeping (body))
+		return;
+
+	counts->active_bodies++;
+	cpBodyEachArbiter (body, profile_count_arbiter, counts);
+}
+
+/*
+	cpBodyEachArbiter callback of profile_space_counts
+
+	Parameters:
+		*body = body the arbiter was found from
+		*arbiter = the arbiter
+		*data = the space_counts
+ */
+static void
+profile_count_arbiter (cpBody *body, cpArbiter *arbiter, void *data) {
+
+	space_counts *counts = (space_counts *)data;
+	cpBody *a, *b;
+
+	cpArbiterGetBodies (arbiter, &a, &b);
+	cpBody *other = (a == body) ? b : a;
+
+	// the other body is only iterated too if it is awake in the space
+	if (cpBodyIsRogue (other) || cpBodyIsSleeping (other) || (uintptr_t)body < (uintptr_t)other)
+		counts->arbiters++;
+}
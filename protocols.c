@@ -9,6 +9,9 @@
 #include "specs/physics.h"
 #include "specs/protocols.h"
 
+// a body that moved less than this since it was last sent is left out
+#define COORDS_EPSILON 1e-3
+
 
 /*
 	checks if the string has a full message
@@ -221,6 +224,48 @@ protocol_decode_zone(char *string) {
     return zone;
 }
 
+/*
+	creates a ping message carrying the time it was sent,
+	which the server echoes back unchanged to the sender
+
+	parameters: send time in seconds
+
+	returns: string with the message
+ */
+char *
+protocol_send_ping(double time) {
+
+    char *result = (char *) calloc(MAXLINE, sizeof(char));
+    assert(result);
+
+    sprintf(result, "%s;%i;%.6f;%s", BEGIN_CHARACTER, PING_MESSAGE, time, END_CHARACTER);
+
+    return result;
+}
+
+/*
+	reads the send time back out of a ping message
+	sister function of protocol_send_ping
+
+	parameters: string message
+
+	returns: send time in seconds
+ */
+double
+protocol_decode_ping(char *message) {
+
+    double time = 0;
+
+    strtok(message, ";"); // Take away beginning characters
+    strtok(NULL, ";"); // Take away ID
+    char *result = strtok(NULL, ";");
+
+    if (result != NULL)
+		sscanf(result, "%lf", &time);
+
+    return time;
+}
+
 
 /*
   	tells all the clients about a new body.
@@ -284,12 +329,19 @@ void body_iterator (cpBody *body, char *string){
 /*
 	returns the string for the server telling the clients about all the
 	body position updates. format: "message type;id1,angle1,x1,y1;id2,angle2,x2,y2;" etc
+	clients keep the last position of bodies that are not in it. only
+	bodies that moved since they were last sent are put in; a sleeping
+	body is left out through the same check, since it does not move.
+	the bodies that do not fit in one message are put in the next, so
+	it is called until it returns NULL
 
-	Parameters: cpSpace space
+	Parameters: world, full: true to put in every body that can move,
+	whether it moved or not, next: id to start from, 0 for the first
+	message of a step, moved past the bodies put in
 
-	returns: string with info
+	returns: string with info, or NULL once no body is left to send
 */
-char *protocol_send_coords( cpSpace *space ){
+char *protocol_send_coords( world_status *world, bool full, int *next ){
 
     char *string = (char * ) calloc(MAXLINE, sizeof(char));
 	char buffer[MAX_COORDINATE_SIZE];
@@ -297,7 +349,98 @@ char *protocol_send_coords( cpSpace *space ){
 	sprintf(buffer, "%s;%i;", BEGIN_CHARACTER, UPDATE_POSITIONS_MESSAGE );
 	strcpy(string, buffer);
 
-	cpSpaceEachBody(space, (cpSpaceBodyIteratorFunc) body_iterator, string );
+	size_t empty = strlen(string);
+	size_t length = empty;
+	body_registry *bodies = &world->bodies;
+
+	int id;
+
+	for (id = *next; id < bodies->count; id++) {
+
+		cpBody *body = bodies->body[id];
+
+		// the ground, removed bodies and static scenery never move
+		if (body == NULL || cpBodyIsStatic(body))
+			continue;
+
+		cpVect pos = cpBodyGetPos(body);
+		cpFloat angle = cpBodyGetAngle(body);
+		cpVect vel = cpBodyGetVel(body);
+
+		if (!full && cpvnear(pos, bodies->sent_pos[id], COORDS_EPSILON)
+				&& cpfabs(angle - bodies->sent_angle[id]) < COORDS_EPSILON
+				&& cpvnear(vel, bodies->sent_vel[id], COORDS_EPSILON))
+			continue;
+
+		if (length + MAX_COORDINATE_SIZE + strlen(END_CHARACTER) >= MAXLINE)
+			break;
+
+		body_iterator(body, string);
+		length = strlen(string);
+
+		bodies->sent_pos[id] = pos;
+		bodies->sent_angle[id] = angle;
+		bodies->sent_vel[id] = vel;
+	}
+
+	*next = id;
+
+	if (length == empty) {
+		free(string);
+		return NULL;
+	}
+
+	strcat(string, END_CHARACTER);
+
+	return string;
+}
+
+/*
+	returns the string for the server telling the clients which bodies
+	were removed for leaving the level. format: "message type;id1;id2;" etc
+	the ids are cleared from the registry as they are put in, and those
+	that do not fit in one message are put in the next, so it is called
+	until it returns NULL
+
+	Parameters: world, next: id to start from, 0 for the first message
+	of a step, moved past the ids put in
+
+	returns: string with info, or NULL once no removal is left to send
+*/
+char *protocol_send_removals( world_status *world, int *next ){
+
+    char *string = (char * ) calloc(MAXLINE, sizeof(char));
+	char buffer[MAX_COORDINATE_SIZE];
+
+	sprintf(buffer, "%s;%i;", BEGIN_CHARACTER, REMOVE_BODY_MESSAGE );
+	strcpy(string, buffer);
+
+	size_t empty = strlen(string);
+	size_t length = empty;
+	body_registry *bodies = &world->bodies;
+	int id;
+
+	for (id = *next; id < bodies->count; id++) {
+
+		if (!bodies->removed[id])
+			continue;
+
+		if (length + MAX_COORDINATE_SIZE + strlen(END_CHARACTER) >= MAXLINE)
+			break;
+
+		sprintf(buffer, "%i;", id);
+		strcat(string, buffer);
+		length = strlen(string);
+
+		bodies->removed[id] = false;
+	}
+
+	*next = id;
+
+	if (length == empty) {
+		free(string);
+		return NULL;
+	}
 
 	strcat(string, END_CHARACTER);
 
@@ -366,11 +509,12 @@ polygon_struct *protocol_extract_body( char *string ){
 
 	Parameters: string from server of format "message type;id1,angle1,x1,y1;id2,angle2,x2,y2;"
 
-	returns: struct with 2 arrays: 1 of vectors and 1 of angles
+	returns: struct with 2 arrays: 1 of vectors and 1 of angles,
+	indexed by id, and their length
  */
 coord_update *protocol_extract_coords( char *string ){
     
-	char string2[strlen(string)];
+	char string2[strlen(string) + 1];
 
     strcpy(string2, string);
 
@@ -424,10 +568,45 @@ coord_update *protocol_extract_coords( char *string ){
 	coord_update *package = (coord_update *) malloc( sizeof( coord_update ));
 	package->angle_array = angle_array;
 	package->vector_array = vector_array;
+	package->count = max_id + 1;
 
 	return package;
 }
 
+/*
+	extracts the ids of the removed bodies from the string received
+	from the server. sister function of protocol_send_removals
+
+	Parameters: string from server of format "message type;id1;id2;"
+	count: set to the number of ids
+
+	returns: array of the ids, to be freed by the caller
+ */
+int *protocol_extract_removals( char *string, int *count ){
+
+	int *ids = (int *) malloc( sizeof( int ) * MAXLINE );
+	if (ids == NULL) {
+		printf("Memory allocation error: in function protocol_extract_removals\n");
+		exit(-1);
+	}
+
+	*count = 0;
+
+	strtok(string, ";"); // Take away beginning characters
+	strtok(NULL, ";"); // skip message type
+	char *result = strtok(NULL, ";");
+
+	while( result != NULL && result[0] != '?' && *count < MAXLINE ) {
+
+		if (sscanf(result, "%i", &ids[*count]) == 1)
+			(*count)++;
+
+		result = strtok( NULL, ";" );
+	}
+
+	return ids;
+}
+
 /*
 	updates the polygon struct with the shape's corners
 	used as an iterator in polygon_from_body()
@@ -463,7 +642,22 @@ polygon_from_body (cpBody *body) {
 	polygon->mass = 1; //This is only used on the server and client doesn't
 	//care about the mass
 
-	cpBodyEachShape (body, (cpBodyShapeIteratorFunc) body_fill_array, polygon);
+	// bodies that never move are sent in world coordinates, since
+	// they are never in a snapshot that would place them
+	if (info->outline != NULL && cpBodyIsStatic(body)) {
+
+		cpVect position = cpBodyGetPos(body);
+		cpVect rotation = cpBodyGetRot(body);
+
+		for (int i = 0; i < info->outline_count; i++) {
+			cpVect point = cpvadd(position, cpvrotate(info->outline[i], rotation));
+			g_array_append_val (polygon->vectors, point);
+		}
+	}
+	else if (info->outline != NULL)
+		g_array_append_vals (polygon->vectors, info->outline, info->outline_count);
+	else
+		cpBodyEachShape (body, (cpBodyShapeIteratorFunc) body_fill_array, polygon);
 
 	polygon->vector_count = polygon->vectors->len;
 
@@ -498,6 +692,7 @@ polygon_struct *polygon_new(){
 int main(int argc, char *argv[]) {
 
 	//test protocol_new_body
+	world_load_levels();
 	world_status *world = world_new( 1 , 0.1 );
 
 	cpBody *ground = world_get_ground( world->space );
@@ -519,7 +714,8 @@ int main(int argc, char *argv[]) {
 
 	//protocol_send_coords
 
-	result = protocol_send_coords( world->space );
+	int next = 0;
+	result = protocol_send_coords( world, true, &next );
 	printf("%s\n", result);
 	//protocol_extract_coords
 	coord_update *update = protocol_extract_coords( result );
@@ -0,0 +1,179 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <chipmunk/chipmunk.h>
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "specs/common.h"
+#include "specs/graphics.h"
+#include "specs/physics.h"
+
+#define DEFAULT_FRAMES 300
+#define FRAME_WIDTH 400
+#define FRAME_HEIGHT 400
+
+/*
+	render_bench.c
+
+	headless rendering benchmark. Loads every levelN.lvl,
+	steps it the same way gui.c does and renders each frame
+	into an offscreen cairo image surface with graphics_render,
+	without ever starting GTK. Reports the mean and p99 frame
+	time per level, and can dump every frame as a PNG for
+	visual regression checks.
+
+	usage: render_bench [frames] [png directory]
+ */
+
+//function prototypes
+static double bench_now (void);
+static int bench_compare (const void *a, const void *b);
+static void bench_level (int level, int frames, const char *png_dir, double *times);
+
+/*
+	returns the current time of the monotonic clock
+
+	Parameters: none
+
+	Returns: time in seconds
+ */
+static double
+bench_now (void) {
+
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+	qsort comparator for frame times
+
+	Parameters: pointers to two doubles
+
+	Returns: negative, zero or positive like strcmp
+ */
+static int
+bench_compare (const void *a, const void *b) {
+
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+	simulates and renders one level, then prints its
+	frame time statistics
+
+	Parameters:
+		level = level number to load
+		frames = number of frames to render
+		*png_dir = directory to write frames to, or NULL
+		*times = scratch array of at least frames doubles
+
+	Returns: nothing
+ */
+static void
+bench_level (int level, int frames, const char *png_dir, double *times) {
+
+	cpFloat time_step = 1.0/60.0;
+
+	world_status *physics = world_new (level, time_step);
+	graphics_world *graphics = graphics_world_new ();
+
+	graphics->space = physics->space;
+
+	if (physics->drawing_box) {
+		graphics->x1 = physics->drawing_box_x1;
+		graphics->y1 = physics->drawing_box_y1;
+		graphics->x2 = physics->drawing_box_x2;
+		graphics->y2 = physics->drawing_box_y2;
+		graphics->display = true;
+	}
+
+	cairo_surface_t *surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, FRAME_WIDTH, FRAME_HEIGHT);
+	cairo_t *cr = cairo_create (surface);
+
+	double total = 0;
+
+	for (int frame = 0; frame < frames; frame++) {
+
+		world_update (physics);
+
+		double start = bench_now ();
+
+		cairo_set_source_rgb (cr, 1, 1, 1);
+		cairo_paint (cr);
+		graphics_render (graphics, cr, FRAME_WIDTH, FRAME_HEIGHT);
+		cairo_surface_flush (surface);
+
+		times[frame] = bench_now () - start;
+		total += times[frame];
+
+		if (png_dir != NULL) {
+
+			char filename[256];
+			snprintf (filename, sizeof(filename), "%s/level%02d_frame%04d.png", png_dir, level, frame);
+
+			if (cairo_surface_write_to_png (surface, filename) != CAIRO_STATUS_SUCCESS)
+				printf("Could not write %s\n", filename);
+		}
+	}
+
+	qsort (times, frames, sizeof(double), bench_compare);
+
+	int p99 = (frames * 99) / 100;
+	if (p99 >= frames)
+		p99 = frames - 1;
+
+	printf("level %2d: %d frames, mean %8.3f ms, p99 %8.3f ms\n", level, frames,
+		   1000 * total / frames, 1000 * times[p99]);
+
+	cairo_destroy (cr);
+	cairo_surface_destroy (surface);
+
+	graphics_world_free (graphics);
+	world_free (physics);
+}
+
+/*
+	main function, benchmarks every level in turn
+
+	parameters: optional frame count and PNG directory
+ */
+int
+main (int argc, char *argv[]) {
+
+	int frames = DEFAULT_FRAMES;
+	const char *png_dir = NULL;
+
+	if (argc > 1)
+		frames = atoi (argv[1]);
+
+	if (argc > 2)
+		png_dir = argv[2];
+
+	if (frames < 1) {
+		printf("usage: render_bench [frames] [png directory]\n");
+		exit(-1);
+	}
+
+	double *times = (double *)malloc(frames * sizeof(double));
+	if (times == NULL) {
+		printf("Memory allocation error: in function main\n");
+		exit(-1);
+	}
+
+	int levels = world_load_levels ();
+
+	for (int level = 1; level <= levels; level++)
+		bench_level (level, frames, png_dir, times);
+
+	free (times);
+
+	return 0;
+}
@@ -0,0 +1,160 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <chipmunk/chipmunk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "specs/common.h"
+#include "specs/physics.h"
+#include "specs/inputlog.h"
+
+/*
+	replay.c
+
+	headless replay of a server input log (server --log).
+	Rebuilds the worlds of the log and applies its inputs
+	at the ticks they were recorded at, stepping the world
+	as fast as it goes in between, with no networking and
+	no sleeps. Each recorded outcome is compared with the
+	state of the replayed world, and the step rate is
+	printed, so a log of a real session is also a benchmark.
+
+	usage: replay file
+
+	Exits with 0 if every outcome matched, 1 otherwise.
+ */
+
+//function prototypes
+static double replay_now (void);
+static world_status *replay_level (world_status *world, int level, float timestep);
+
+/*
+	returns the current time of the monotonic clock
+
+	Parameters: none
+
+	Returns: time in seconds
+ */
+static double
+replay_now (void) {
+
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+	starts a round of a level the way the server does:
+	a retry resets the world, another level builds a new one
+
+	Parameters:
+		*world = current world, or NULL
+		level = level of the round
+		timestep = time of one world step
+
+	Returns: the world of the round
+ */
+static world_status *
+replay_level (world_status *world, int level, float timestep) {
+
+	if (world != NULL && world->level == level) {
+		world_reset (world);
+	}
+	else {
+		if (world != NULL)
+			world_free (world);
+
+		world = world_new (level, timestep);
+	}
+
+	cpSpaceSetIterations (world->space, world->iterations);
+
+	return world;
+}
+
+/*
+	main function, replays one log
+
+	parameters: the log file
+ */
+int
+main (int argc, char *argv[]) {
+
+	if (argc != 2) {
+		printf("usage: replay file\n");
+		exit(-1);
+	}
+
+	float timestep;
+	FILE *log = input_log_read_open (argv[1], &timestep);
+	if (log == NULL) {
+		printf("%s is not an input log\n", argv[1]);
+		exit(-1);
+	}
+
+	world_load_levels ();
+
+	world_status *world = NULL;
+	input_event event;
+	memset (&event, 0, sizeof event);
+
+	long tick = 0;
+	int outcomes = 0, mismatches = 0, bodies = 0;
+	double start = replay_now ();
+
+	while (input_log_read (log, &event)) {
+
+		if (world == NULL && event.kind != INPUT_LEVEL) {
+			printf("tick %ld: input before the first level\n", event.tick);
+			exit(-1);
+		}
+
+		for (; world != NULL && tick < event.tick; tick++)
+			world_update (world);
+
+		if (event.kind == INPUT_LEVEL) {
+			world = replay_level (world, event.level, timestep);
+		}
+		else if (event.kind == INPUT_BODY) {
+			create_user_object (event.vectors, event.vector_count, event.color, world,
+				PLAYER_BOX_COLLISION_NUMBER, 1, event.mass);
+			bodies++;
+		}
+		else if (event.kind == INPUT_ITERATIONS) {
+			cpSpaceSetIterations (world->space, event.iterations);
+		}
+		else {
+			uint64_t checksum = world_checksum (world);
+			bool match = world->level == event.level && world->status == event.status
+				&& checksum == event.checksum;
+
+			printf("tick %8ld  level %2d  status %d  %s\n", event.tick, event.level,
+				   event.status, match ? "match" : "MISMATCH");
+
+			outcomes++;
+			if (!match)
+				mismatches++;
+		}
+	}
+
+	double seconds = replay_now () - start;
+
+	bool complete = feof (log);
+
+	if (!complete)
+		printf("stopped at a line that cannot be read\n");
+
+	printf("%ld steps, %d bodies in %.3f s: %.0f steps/s, %.1fx real time\n", tick, bodies,
+		   seconds, (seconds > 0) ? tick / seconds : 0, (seconds > 0) ? tick * timestep / seconds : 0);
+	printf("%d of %d outcomes matched\n", outcomes - mismatches, outcomes);
+
+	input_event_free (&event);
+	fclose (log);
+	if (world != NULL)
+		world_free (world);
+
+	return (mismatches == 0 && outcomes > 0 && complete) ? 0 : 1;
+}
@@ -15,11 +15,20 @@
 #include "specs/physics.h"
 #include "specs/networking.h"
 #include "specs/protocols.h"
+#include "specs/inputlog.h"
+#include "specs/profile.h"
 
 #define NEW_PLAYER 30001 // Port used to listen for new players
 #define TIMESTEP 1.0/60.0
 #define EXTRA_TIME 10000
 
+// microseconds a room's physics step may take on average; above it the solver
+// iterations are lowered one at a time, down to MIN_ITERATIONS, and under half
+// of it they are raised again up to what the level asks for
+#define STEP_BUDGET 2000
+#define MIN_ITERATIONS 2
+#define QUALITY_INTERVAL 30 // steps between two changes
+
 /*
 	server.c
 
@@ -27,6 +36,14 @@
     and a chipmunk space; it will accept new body messages and level change messages
 	from a client, update accordingly its world_struct and chipmunk space accordingly,
 	all while updating all clients of updates to body positions. 
+
+	usage: server [--log file] [--profile file]
+
+	With --log, every input that changes the world is written
+	to file, which the replay tool can play back. With
+	--profile, every world step is profiled and the
+	histograms of every level played are written to file at
+	each level switch and when the server exits.
  */
 
 
@@ -49,6 +66,13 @@ typedef struct {
     int try_number;
     int level;
     world_status *world;
+    double step_time; // moving average of the step time, in microseconds
+    int iterations;
+    int steps_since_change;
+    FILE *log; // input log, NULL when not logging
+    long tick; // world steps taken since the server started
+    profiler *profiler; // NULL when not profiling
+    const char *profile_file;
 
 } broadcast_info;
 
@@ -61,7 +85,10 @@ static void server_add_body(broadcast_info *info);
 static void server_send_initial_bodies(cpBody *body, broadcast_info *info);
 static void free_message(broadcast_info *info);
 static void server_send_world_info(broadcast_info *info);
+static void server_send_coords(broadcast_info *info, bool full);
 static void server_switch_level(broadcast_info *info, int level, bool win);
+static void server_scale_quality(broadcast_info *info, gint64 step_time);
+static void server_dump_profile(broadcast_info *info);
 
 /*
 	initializes a new broadcast_info 
@@ -88,6 +115,13 @@ new_broadcast_info(fd_set *master_readfds, int new_player_listener, int fdmax) {
     info -> sender_fd = 0;
     info -> level = 1;
     info -> world = NULL;
+    info -> step_time = 0;
+    info -> iterations = 0;
+    info -> steps_since_change = 0;
+    info -> log = NULL;
+    info -> tick = 0;
+    info -> profiler = NULL;
+    info -> profile_file = NULL;
 
     return info;
 }
@@ -178,6 +212,12 @@ server_select(struct timeval *tv, broadcast_info *info) {
 						level_info *level_switch_info = protocol_decode_level(buf);
 						server_switch_level(info, level_switch_info -> level, false);
 		    		}
+
+		    		// Ping from a client measuring its round trip time, echoed only to it
+		    		else if(buf[ID_INDEX] == PING_MESSAGE + '0') {
+						if (sendall(i, buf, MAXLINE) == -1)
+							perror("send");
+		    		}
 				}
 		
 				// Errors or client dropped
@@ -235,10 +275,25 @@ server_broadcast_message(broadcast_info *info) {
 static void
 server_world_step(broadcast_info *info) {
 
+    // a settled round has nothing left to simulate or send
+    if (info -> world -> settled)
+		return;
+
+    gint64 start = g_get_monotonic_time();
     world_update(info -> world);
-    info -> message = protocol_send_coords(info -> world -> space);
-    info -> skip_sender_fd = false;
-    server_broadcast_message(info);
+    gint64 step_time = g_get_monotonic_time() - start;
+    info -> tick++;
+
+    // counted and drained outside the timed step, so that profiling does
+    // not lower the quality
+    if (info -> profiler) {
+		world_profile(info -> world);
+		profiler_drain(info -> profiler);
+    }
+    server_scale_quality(info, step_time);
+
+    // nothing is sent while every body is asleep
+    server_send_coords(info, false);
 
 	//if a new level is desired, switches level
     if (info -> world->status == 1) {
@@ -249,6 +304,62 @@ server_world_step(broadcast_info *info) {
     }
 }
 
+/*
+	lowers the solver iterations of the room when its steps
+	take longer than the budget, and raises them back towards
+	the level's own when there is room again
+
+	parameters: broadcast_info struct pointer, duration of the
+	last step in microseconds
+
+	returns: nothing
+ */
+static void
+server_scale_quality(broadcast_info *info, gint64 step_time) {
+
+    info -> step_time = 0.9 * info -> step_time + 0.1 * step_time;
+
+    if (info -> steps_since_change < QUALITY_INTERVAL) {
+		info -> steps_since_change++;
+		return;
+    }
+
+    int iterations = info -> iterations;
+
+    if (info -> step_time > STEP_BUDGET && iterations > MIN_ITERATIONS)
+		iterations--;
+    else if (info -> step_time < STEP_BUDGET / 2 && iterations < info -> world -> iterations)
+		iterations++;
+
+    if (iterations != info -> iterations) {
+
+		info -> iterations = iterations;
+		info -> steps_since_change = 0;
+		cpSpaceSetIterations(info -> world -> space, iterations);
+
+		// the change depends on timing, so a replay has to be told
+		if (info -> log)
+			input_log_iterations(info -> log, info -> tick, iterations);
+    }
+}
+
+/*
+	writes the step histograms of every level played so far
+	to the profile file
+
+	parameters: broadcast_info struct pointer
+
+	returns: nothing
+ */
+static void
+server_dump_profile(broadcast_info *info) {
+
+    profiler_drain(info -> profiler);
+
+    if (!profiler_dump(info -> profiler, info -> profile_file))
+		perror(info -> profile_file);
+}
+
 /*
 	adds the body received from client 
 
@@ -269,32 +380,21 @@ server_add_body(broadcast_info *info) {
 
     polygon_struct *body_info = protocol_extract_body(info -> message);
 
+    if (info -> log)
+		input_log_body(info -> log, info -> tick, conv_color(body_info -> color), body_info -> mass,
+			       (cpVect *)body_info -> vectors -> data, body_info -> vector_count);
+
     body_info -> body_id = create_user_object((cpVect *)body_info -> vectors ->
 		data, body_info -> vector_count, conv_color(body_info -> color),
 		info -> world, PLAYER_BOX_COLLISION_NUMBER, 1, body_info->mass);
 
-    cpVect average = cpv(0,0);
-    cpVect *vect = (cpVect *) (body_info->vectors->data);
-
-	// sum up the x and y values
-    for (int i = 0; i < body_info->vector_count; i++) {
-		average.x += vect[i].x;
-		average.y += vect[i].y;
-    }
-	
-
-	// divide by the vector count to get the average
-    average.x /= body_info->vector_count;
-    average.y /= body_info->vector_count;
+    // the outline relative to where physics placed the body
+    polygon_struct *outline = polygon_from_body(world_get_body(info -> world, body_info -> body_id));
 
-    cpVect vertices[body_info->vector_count];
-    
-	for (int i = 0; i < body_info->vector_count; i++) {
-		vertices[i] = cpvsub (vect[i], average);
-    }
+    info -> message = protocol_new_body(body_info -> color, (cpVect *)outline -> vectors -> data,
+					outline -> vector_count, body_info -> body_id, 1);
 
-    info -> message = protocol_new_body(body_info -> color, vertices, body_info -> vector_count,
-					body_info -> body_id, 1);
+    polygon_destroy(outline);
 
     server_broadcast_message(info);
     usleep(EXTRA_TIME * 5);
@@ -349,8 +449,15 @@ static void
 server_send_world_info(broadcast_info *info) {
     
 	server_send_initial_bodies(world_get_ground(info -> world -> space), info);
-    cpSpaceEachBody(info -> world -> space, (cpSpaceBodyIteratorFunc)
-		    server_send_initial_bodies, info);
+
+    // every other body by id, static and kinematic scenery included
+    for (int id = 0; id < info -> world -> bodies.count; id++) {
+
+		cpBody *body = info -> world -> bodies.body[id];
+
+		if (body != NULL)
+			server_send_initial_bodies(body, info);
+    }
 
     if (info -> world->drawing_box) {
 		
@@ -361,6 +468,45 @@ server_send_world_info(broadcast_info *info) {
 
 	server_broadcast_message(info);
     }
+
+    // sleeping bodies are left out of the per step updates, so
+    // everyone gets the current position of every body once
+    free_message(info);
+    server_send_coords(info, true);
+}
+
+/*
+	broadcasts the bodies removed since the last call, then
+	the positions of the bodies, in as many messages as
+	they take
+
+	parameters: broadcast_info struct pointer, full: true to
+	send every body that can move, not only those that moved
+
+	returns: nothing, the message is left NULL
+ */
+static void
+server_send_coords(broadcast_info *info, bool full) {
+
+    int next = 0;
+
+    info -> skip_sender_fd = false;
+
+    // the message it is called with may be the receive buffer, so only
+    // the messages made here are freed
+    while ((info -> message = protocol_send_removals(info -> world, &next)) != NULL) {
+
+		server_broadcast_message(info);
+		free_message(info);
+    }
+
+    next = 0;
+
+    while ((info -> message = protocol_send_coords(info -> world, full, &next)) != NULL) {
+
+		server_broadcast_message(info);
+		free_message(info);
+    }
 }
 
 /*
@@ -373,11 +519,6 @@ server_send_world_info(broadcast_info *info) {
 static void 
 server_switch_level(broadcast_info *info, int level, bool win) {
 
-    if(info->world) {
-		world_free(info -> world);
-		info->world = NULL;
-	}
-
     // Check which level should be loaded
     if(win)
 		info->level = info->level % 10 + 1;
@@ -388,8 +529,33 @@ server_switch_level(broadcast_info *info, int level, bool win) {
 
 	info->try_number = 0;
 
-    // Create new world
-    info -> world = world_new(info -> level, TIMESTEP);
+    if (info -> log) {
+		if (info -> world)
+			input_log_outcome(info -> log, info -> tick, info -> world);
+		input_log_level(info -> log, info -> tick, info -> level);
+    }
+
+    if (info -> profiler && info -> world)
+		server_dump_profile(info);
+
+    // A retry keeps the world and only puts the level back
+    if(info->world && info->world->level == info->level) {
+		world_reset(info -> world);
+    }
+    else {
+		if(info->world)
+			world_free(info -> world);
+
+		info -> world = world_new(info -> level, TIMESTEP);
+
+		if (info -> profiler)
+			world_set_profile(info -> world, &info -> profiler -> ring);
+    }
+
+    // every round starts at the solver quality of its level
+    info -> iterations = info -> world -> iterations;
+    info -> steps_since_change = 0;
+    cpSpaceSetIterations(info -> world -> space, info -> iterations);
 
     // Send instruction to kill current world and send info to populate new world
     info -> message = protocol_send_level(info -> level, info -> try_number);
@@ -414,10 +580,36 @@ main(int argc, char **argv) {
     FD_SET(new_player_listener_fd, &master_readfds);
     fdmax = new_player_listener_fd + 1;
 
+    if (world_load_levels() == 0) {
+		printf("No levels found\n");
+		exit(-1);
+    }
+
     // Start game: create world_new and send level information to all clients
     broadcast_info *info = new_broadcast_info(&master_readfds,
 					      new_player_listener_fd, fdmax);
 
+    for (int arg = 1; arg < argc; arg += 2) {
+
+		if (arg + 1 < argc && strcmp(argv[arg], "--log") == 0) {
+
+			info -> log = input_log_open(argv[arg + 1], TIMESTEP);
+			if (info -> log == NULL) {
+				perror(argv[arg + 1]);
+				exit(-1);
+			}
+		}
+		else if (arg + 1 < argc && strcmp(argv[arg], "--profile") == 0) {
+
+			info -> profiler = profiler_new();
+			info -> profile_file = argv[arg + 1];
+		}
+		else {
+			printf("usage: server [--log file] [--profile file]\n");
+			exit(-1);
+		}
+    }
+
     server_switch_level(info, 1, false);
     struct timeval tv;
     tv.tv_sec = 0;
@@ -426,7 +618,9 @@ main(int argc, char **argv) {
     while(!info -> game_started || info -> num_players > 0) {
 
 		server_world_step(info);
-		server_select(&tv, info);
+
+		// nothing changes in a settled round until a client sends something
+		server_select(info -> world -> settled ? NULL : &tv, info);
 		usleep(5000);
     }
 
@@ -437,6 +631,16 @@ main(int argc, char **argv) {
 	    	close(i);
     }
 
+    if (info -> log) {
+		input_log_outcome(info -> log, info -> tick, info -> world);
+		fclose(info -> log);
+    }
+
+    if (info -> profiler) {
+		server_dump_profile(info);
+		profiler_free(info -> profiler);
+    }
+
     // Freeing the world
     world_free(info -> world);
     free(info);
@@ -0,0 +1,406 @@
+#define _XOPEN_SOURCE 700
+
+#include <chipmunk/chipmunk.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "specs/common.h"
+#include "specs/physics.h"
+
+#define DEFAULT_CANDIDATES 2000
+#define DEFAULT_SECONDS 10
+#define DEFAULT_SHOWN 10
+#define MIN_SIZE 0.5 // smallest side of a candidate shape
+
+/*
+	solver.c
+
+	headless search for the drops that win a level. Generates
+	candidate shapes (boxes, planks, triangles and wedges of
+	different sizes, angles and masses) inside the drawing
+	zone of the level, drops each one on its own into the
+	level, and steps it until the target is hit, the round
+	settles or the time runs out. Candidates are shared out
+	to a pool of threads; each thread builds one world of
+	the level and resets it between candidates, and every
+	world is built from the same level template, which is
+	loaded once before the threads start and only read after.
+	The winning drops are printed, fastest first.
+
+	usage: solver [-t threads] [-n candidates] [-s seconds] level
+ */
+
+typedef enum {
+
+	CANDIDATE_BOX = 0,
+	CANDIDATE_PLANK,
+	CANDIDATE_TRIANGLE,
+	CANDIDATE_WEDGE,
+	CANDIDATE_KINDS
+
+} candidate_kind;
+
+typedef struct {
+	candidate_kind kind;
+	cpVect center;
+	cpFloat width;
+	cpFloat height;
+	cpFloat angle;
+	cpFloat mass;
+	bool hit;
+	long steps; // until the hit, or until the candidate was given up on
+} candidate;
+
+typedef struct {
+	int level;
+	long max_steps;
+	candidate *candidates;
+	int candidate_count;
+	int next; // first candidate no thread has taken yet
+	long total_steps;
+	pthread_mutex_t lock;
+} solver_job;
+
+//function prototypes
+static double solver_now (void);
+static uint32_t solver_random (uint32_t *state);
+static cpFloat solver_uniform (uint32_t *state, cpFloat low, cpFloat high);
+static void solver_generate (candidate *candidates, int count, cpBB zone);
+static int solver_outline (candidate *drop, cpVect *outline);
+static void solver_run (world_status *world, candidate *drop, long max_steps);
+static void *solver_thread (void *data);
+static int solver_compare (const void *a, const void *b);
+
+static const char *kind_names[CANDIDATE_KINDS] = { "box", "plank", "triangle", "wedge" };
+static const cpFloat masses[] = { 0.5, 1, 2, 4, 8 };
+
+/*
+	returns the current time of the monotonic clock
+
+	Parameters: none
+
+	Returns: time in seconds
+ */
+static double
+solver_now (void) {
+
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+	xorshift32, so that the candidates of a level are the
+	same on every run and every machine
+
+	Parameters:
+		*state = generator state, not 0
+
+	Returns: the next number
+ */
+static uint32_t
+solver_random (uint32_t *state) {
+
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+
+	return x;
+}
+
+/*
+	Parameters:
+		*state = generator state
+		low, high = range
+
+	Returns: a number evenly spread between low and high
+ */
+static cpFloat
+solver_uniform (uint32_t *state, cpFloat low, cpFloat high) {
+
+	return low + (high - low) * (solver_random (state) / 4294967296.0);
+}
+
+/*
+	makes up the candidates, each one small enough to fit
+	the zone whatever its angle
+
+	Parameters:
+		*candidates = array to fill
+		count = number of candidates
+		zone = drawing zone of the level
+ */
+static void
+solver_generate (candidate *candidates, int count, cpBB zone) {
+
+	uint32_t state = 2463534242u;
+	cpFloat room = cpfmin (zone.r - zone.l, zone.t - zone.b);
+
+	for (int i = 0; i < count; i++) {
+
+		candidate *drop = &candidates[i];
+
+		drop->kind = (candidate_kind)(i % CANDIDATE_KINDS);
+		drop->width = solver_uniform (&state, MIN_SIZE, cpfmax (MIN_SIZE, room / 2));
+		drop->height = (drop->kind == CANDIDATE_PLANK) ? drop->width / 8
+			: solver_uniform (&state, MIN_SIZE, cpfmax (MIN_SIZE, room / 2));
+		drop->angle = solver_uniform (&state, 0, M_PI);
+		drop->mass = masses[solver_random (&state) % (sizeof masses / sizeof masses[0])];
+
+		cpFloat reach = cpvlength (cpv(drop->width, drop->height)) / 2;
+		cpFloat x = (zone.r - zone.l > 2 * reach) ? solver_uniform (&state, zone.l + reach, zone.r - reach)
+			: (zone.l + zone.r) / 2;
+		cpFloat y = (zone.t - zone.b > 2 * reach) ? solver_uniform (&state, zone.b + reach, zone.t - reach)
+			: (zone.b + zone.t) / 2;
+
+		drop->center = cpv(x, y);
+		drop->hit = false;
+		drop->steps = 0;
+	}
+}
+
+/*
+	builds the outline of a candidate in world coordinates
+
+	Parameters:
+		*drop = the candidate
+		*outline = array of at least 4 points to fill
+
+	Returns: number of points
+ */
+static int
+solver_outline (candidate *drop, cpVect *outline) {
+
+	cpFloat w = drop->width / 2, h = drop->height / 2;
+	int count;
+
+	if (drop->kind == CANDIDATE_TRIANGLE) {
+		outline[0] = cpv(-w, -h);
+		outline[1] = cpv(0, h);
+		outline[2] = cpv(w, -h);
+		count = 3;
+	}
+	else if (drop->kind == CANDIDATE_WEDGE) {
+		outline[0] = cpv(-w, -h);
+		outline[1] = cpv(-w, h);
+		outline[2] = cpv(w, -h);
+		count = 3;
+	}
+	else {
+		outline[0] = cpv(-w, -h);
+		outline[1] = cpv(-w, h);
+		outline[2] = cpv(w, h);
+		outline[3] = cpv(w, -h);
+		count = 4;
+	}
+
+	cpVect rotation = cpvforangle (drop->angle);
+
+	for (int i = 0; i < count; i++)
+		outline[i] = cpvadd (drop->center, cpvrotate (outline[i], rotation));
+
+	return count;
+}
+
+/*
+	drops one candidate into a fresh round of the world and
+	steps it until the target is hit, the round settles or
+	max_steps have been taken
+
+	Parameters:
+		*world = world of the level, reset here
+		*drop = candidate, its result is filled in
+		max_steps = steps before giving up
+ */
+static void
+solver_run (world_status *world, candidate *drop, long max_steps) {
+
+	cpVect outline[4];
+	int count = solver_outline (drop, outline);
+
+	world_reset (world);
+	create_user_object (outline, count, RED, world, PLAYER_BOX_COLLISION_NUMBER, 1, drop->mass);
+
+	long step = 0;
+
+	while (step < max_steps && world->status != 1 && !world->settled) {
+		world_update (world);
+		step++;
+	}
+
+	drop->hit = (world->status == 1);
+	drop->steps = step;
+}
+
+/*
+	worker of the pool: takes the next candidate until there
+	are none left
+
+	Parameters:
+		*data = the solver_job
+
+	Returns: NULL
+ */
+static void *
+solver_thread (void *data) {
+
+	solver_job *job = (solver_job *)data;
+	world_status *world = world_new (job->level, 1.0/60.0);
+	long steps = 0;
+
+	while (true) {
+
+		pthread_mutex_lock (&job->lock);
+		int index = job->next++;
+		pthread_mutex_unlock (&job->lock);
+
+		if (index >= job->candidate_count)
+			break;
+
+		solver_run (world, &job->candidates[index], job->max_steps);
+		steps += job->candidates[index].steps;
+	}
+
+	world_free (world);
+
+	pthread_mutex_lock (&job->lock);
+	job->total_steps += steps;
+	pthread_mutex_unlock (&job->lock);
+
+	return NULL;
+}
+
+/*
+	qsort comparator ranking hits first, fastest first
+
+	Parameters: pointers to two candidates
+
+	Returns: negative, zero or positive like strcmp
+ */
+static int
+solver_compare (const void *a, const void *b) {
+
+	const candidate *x = (const candidate *)a;
+	const candidate *y = (const candidate *)b;
+
+	if (x->hit != y->hit)
+		return x->hit ? -1 : 1;
+
+	return (x->steps > y->steps) - (x->steps < y->steps);
+}
+
+/*
+	main function, searches the drops of one level
+
+	parameters: optional -t thread count, -n candidate count,
+		-s simulated seconds per candidate, and the level
+ */
+int
+main (int argc, char *argv[]) {
+
+	int threads = (int)sysconf (_SC_NPROCESSORS_ONLN);
+	int count = DEFAULT_CANDIDATES;
+	double seconds = DEFAULT_SECONDS;
+	int level = 0;
+
+	for (int arg = 1; arg < argc; arg++) {
+
+		if (strcmp (argv[arg], "-t") == 0 && arg + 1 < argc)
+			threads = atoi (argv[++arg]);
+		else if (strcmp (argv[arg], "-n") == 0 && arg + 1 < argc)
+			count = atoi (argv[++arg]);
+		else if (strcmp (argv[arg], "-s") == 0 && arg + 1 < argc)
+			seconds = atof (argv[++arg]);
+		else
+			level = atoi (argv[arg]);
+	}
+
+	if (level < 1 || threads < 1 || count < 1 || seconds <= 0) {
+		printf("usage: solver [-t threads] [-n candidates] [-s seconds] level\n");
+		exit(-1);
+	}
+
+	// every thread builds its world from these templates, so they are
+	// all loaded before any thread starts
+	world_load_levels ();
+
+	world_status *world = world_new (level, 1.0/60.0);
+	if (!world->drawing_box) {
+		printf("level %d has no drawing zone\n", level);
+		exit(-1);
+	}
+
+	cpBB zone = cpBBNew (cpfmin (world->drawing_box_x1, world->drawing_box_x2),
+		cpfmin (world->drawing_box_y1, world->drawing_box_y2),
+		cpfmax (world->drawing_box_x1, world->drawing_box_x2),
+		cpfmax (world->drawing_box_y1, world->drawing_box_y2));
+	world_free (world);
+
+	solver_job job;
+	job.level = level;
+	job.max_steps = (long)(seconds * 60);
+	job.candidate_count = count;
+	job.next = 0;
+	job.total_steps = 0;
+	job.candidates = (candidate *)malloc(count * sizeof(candidate));
+	pthread_t *pool = (pthread_t *)malloc(threads * sizeof(pthread_t));
+
+	if (job.candidates == NULL || pool == NULL) {
+		printf("Memory allocation error: in function main\n");
+		exit(-1);
+	}
+
+	pthread_mutex_init (&job.lock, NULL);
+	solver_generate (job.candidates, count, zone);
+
+	double start = solver_now ();
+
+	for (int i = 0; i < threads; i++) {
+		if (pthread_create (&pool[i], NULL, solver_thread, &job) != 0) {
+			printf("cannot start thread %d\n", i);
+			exit(-1);
+		}
+	}
+
+	for (int i = 0; i < threads; i++)
+		pthread_join (pool[i], NULL);
+
+	double elapsed = solver_now () - start;
+
+	qsort (job.candidates, count, sizeof(candidate), solver_compare);
+
+	int hits = 0;
+	while (hits < count && job.candidates[hits].hit)
+		hits++;
+
+	printf("level %d: %d of %d candidates hit the target\n", level, hits, count);
+	printf("%d threads, %.3f s, %.0f candidates/s, %.0f steps/s\n", threads, elapsed,
+		   count / elapsed, job.total_steps / elapsed);
+
+	if (hits > 0)
+		printf(" rank | shape    |       x       y | width height | angle |  mass | time\n");
+
+	for (int i = 0; i < hits && i < DEFAULT_SHOWN; i++) {
+
+		candidate *drop = &job.candidates[i];
+
+		printf("%5d | %-8s | %7.2f %7.2f | %5.2f %6.2f | %5.2f | %5.1f | %4.2f s\n", i + 1,
+			   kind_names[drop->kind], drop->center.x, drop->center.y, drop->width, drop->height,
+			   drop->angle, drop->mass, drop->steps / 60.0);
+	}
+
+	pthread_mutex_destroy (&job.lock);
+	free (pool);
+	free (job.candidates);
+
+	return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+  Bump allocator that owns the memory of one world: its bodies, shapes,
+  body_information structs and outlines.  Allocations are never freed one by
+  one; the arena is rewound to a mark taken earlier, which releases everything
+  allocated since in one go, or freed as a whole.  Blocks are kept when
+  rewinding, so a world that is reset over and over stops calling malloc.
+ */
+
+typedef struct arena_block arena_block;
+
+typedef struct arena {
+    arena_block *first;
+    arena_block *current;
+    size_t block_size;
+} arena;
+
+/*
+  Creates an empty arena.
+
+  Parameters:
+      block_size = bytes malloced at a time; larger allocations get a block of
+      their own
+
+  Returns: the arena, to be released with arena_free
+ */
+arena *arena_new (size_t block_size);
+
+/*
+  Allocates size bytes aligned for any type.  The memory is not cleared.
+ */
+void *arena_alloc (arena *arena, size_t size);
+
+/*
+  Returns: the position of the next allocation, to rewind to later
+ */
+size_t arena_mark (arena *arena);
+
+/*
+  Releases everything allocated after mark was taken.
+ */
+void arena_rewind (arena *arena, size_t mark);
+
+void arena_free (arena *arena);
+
+#endif
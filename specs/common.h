@@ -18,12 +18,18 @@ typedef enum {
 /* 
 	body_information struct 
 
-	contains the body id and the color
+	contains the body id and the color, and the outline
+	of the body relative to its position (world coordinates
+	for the ground), which graphics and protocols use instead
+	of walking the shapes; NULL where the body is only made
+	of segments, as on the client
 */
 typedef struct {
 
 	COLOR color;
 	int body_id;
+	struct cpVect *outline;
+	int outline_count;
 
 } body_information;
 
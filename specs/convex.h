@@ -0,0 +1,42 @@
+#ifndef CONVEX_H
+#define CONVEX_H
+
+/*
+  Convex decomposition of simple polygons, used to turn drawn and level
+  outlines into cpPolyShapes.  The outline is triangulated by ear clipping,
+  and neighbouring pieces are then merged for as long as the result stays
+  convex (Hertel-Mehlhorn), which leaves at most four times the minimum
+  number of pieces and usually one or two for a drawing.
+ */
+
+typedef struct {
+    cpVect *vertices; // every piece back to back, each one clockwise
+    int *sizes; // number of vertices of each piece
+    int *offsets; // index of the first vertex of each piece
+    int piece_count;
+    cpFloat area;
+    cpVect centroid;
+} convex_pieces;
+
+/*
+  Decomposes an outline in either winding into convex pieces.  Repeated and
+  collinear points are dropped first.
+
+  Parameters:
+      *outline = polygon to decompose
+      count = number of points
+
+  Returns: the pieces, to be released with convex_free, or NULL if the
+  outline has less than three distinct corners, no area, or crosses itself
+ */
+convex_pieces *convex_decompose (cpVect *outline, int count);
+
+/*
+  Moment of inertia of the pieces about a point, with the mass spread
+  evenly over their area.
+ */
+cpFloat convex_moment (convex_pieces *pieces, cpFloat mass, cpVect center);
+
+void convex_free (convex_pieces *pieces);
+
+#endif
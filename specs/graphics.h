@@ -11,6 +11,46 @@
  */
 
 
+/*
+  Size of the part of the world shown in the window at zoom 1.
+ */
+#define GRAPHICS_SPACE_WIDTH 50
+#define GRAPHICS_SPACE_HEIGHT 50
+
+/*
+  The camera decides which part of the world is shown.  center is the world
+  point drawn in the middle of the window and zoom is 1 when the window shows
+  GRAPHICS_SPACE_WIDTH by GRAPHICS_SPACE_HEIGHT world units.
+ */
+typedef struct {
+    cpVect center;
+    float zoom;
+} graphics_camera;
+
+/*
+  Rolling statistics for the performance overlay.  The counters collect one
+  window of about a second; when it is over they are turned into the rates
+  and averages that are drawn, and start again.  Nothing is timed or counted
+  while the overlay is hidden.
+ */
+typedef struct {
+    bool visible;
+    double window_start; // start of the current window, in seconds
+    int frames; // counters of the current window
+    double render_time;
+    int snapshots;
+    double decode_time;
+    double apply_time;
+    long bytes;
+    double fps; // values of the last complete window
+    double frame_ms;
+    double snapshot_rate;
+    double decode_ms;
+    double apply_ms;
+    double bytes_rate;
+    double rtt_ms; // last round trip time to the server, negative if unknown
+} graphics_hud;
+
 typedef struct  {
     cpSpace *space;
     bool display; // whether the drawing box should be displayed
@@ -25,16 +65,42 @@ typedef struct  {
 	GArray *user_points;
 	COLOR color;
 	cairo_surface_t *image;
+	cairo_surface_t *overlay; // the player's stroke, drawn one segment at a time
+	int overlay_points; // number of user_points already drawn onto the overlay
+	double overlay_length; // screen length of the stroke so far, keeps the dashes continuous
+	GArray *preview; // cpVects of the predicted path of the stroke, empty when there is none
+	bool preview_hit; // whether the predicted path reaches the target
+	cpVect *previous_pos; // poses before the last step by body id, NULL to draw the current ones
+	cpFloat *previous_angle;
+	int previous_count;
+	float interpolation; // 0 draws bodies in their previous poses, 1 in their current ones
+	graphics_camera camera;
+	graphics_hud hud;
 } graphics_world;
 
 
 /*
-  The iterate_space function will be used to look through all the items in world
+  Allocates a graphics_world with every field set to its empty value and an
+  empty user_points array.  The caller still sets the space and the widgets.
+
+  Returns: pointer to the new graphics_world
+ */
+graphics_world *graphics_world_new (void);
+
+/*
+  Frees a graphics_world with its arrays, overlay and message.  The space,
+  the widgets and the previous poses are not its own and are left alone.
+ */
+void graphics_world_free (graphics_world *world);
+
+
+/*
+  The graphics_space_iterate function will be used to look through all the items in world
   and display them one at a time (by using other functions). This will be called
-  directly by the GUI callback within the GUI file.
+  directly by the GUI callback within the GUI file, after it sets cr to the
+  context of the draw signal; only the bodies under its clip are drawn.
 
   Parameters:
-      cairo_t *cr - pointer to the cairo context
       graphics_world *world - pointer to the graphics_world struct
 
   Returns: nothing
@@ -42,4 +108,100 @@ typedef struct  {
 void graphics_space_iterate (graphics_world *world);
 
 
+/*
+  Draws the drawing zone, the predicted path of the player's stroke, the
+  stroke, every body inside the clip of the context and the message into
+  an arbitrary cairo context.  Does not touch GTK, so it can render into an
+  image surface on a machine without a display.  graphics_space_iterate is a
+  thin wrapper around it for the GTK window.
+
+  Parameters:
+      graphics_world *world - pointer to the graphics_world struct
+      cairo_t *cr - cairo context to draw into
+      int width - width of the context in pixels
+      int height - height of the context in pixels
+
+  Returns: nothing
+ */
+void graphics_render (graphics_world *world, cairo_t *cr, int width, int height);
+
+
+/*
+  Converts a pixel of the drawing screen into world coordinates for the
+  current camera.  Used by gui.c and client.c to turn mouse input into points.
+
+  Parameters:
+      graphics_world *world - pointer to the graphics_world struct
+      double x, y - pixel coordinates in the drawing screen
+
+  Returns: the point in world coordinates
+ */
+cpVect graphics_screen_to_world (graphics_world *world, double x, double y);
+
+
+/*
+  Camera controls.  graphics_camera_reset shows the default 50x50 world,
+  graphics_camera_zoom zooms by factor keeping the world point under pixel
+  (x, y) in place, and graphics_camera_pan moves by fractions of the visible
+  area.  graphics_camera_key maps + - 0 and the arrow keys onto these, and
+  graphics_camera_scroll zooms around the mouse with the scroll wheel; both
+  return true if they handled the event.
+ */
+void graphics_camera_reset (graphics_world *world);
+
+void graphics_camera_zoom (graphics_world *world, float factor, double x, double y);
+
+void graphics_camera_pan (graphics_world *world, float dx, float dy);
+
+bool graphics_camera_key (graphics_world *world, guint keyval);
+
+bool graphics_camera_scroll (graphics_world *world, GdkScrollDirection direction, double x, double y);
+
+
+/*
+  Performance overlay.  graphics_hud_now returns a monotonic time in seconds
+  to time work with.  graphics_hud_toggle shows or hides the overlay and
+  resets its statistics.  The client records every message it receives with
+  graphics_hud_received, the decode and pose apply time of every position
+  snapshot with graphics_hud_snapshot, and ping replies with graphics_hud_rtt.
+  Frame rate and render time are recorded by graphics_space_iterate itself.
+  Callers should check hud.visible before timing anything.
+ */
+double graphics_hud_now (void);
+
+void graphics_hud_toggle (graphics_world *world);
+
+void graphics_hud_received (graphics_world *world, int bytes);
+
+void graphics_hud_snapshot (graphics_world *world, double decode_time, double apply_time);
+
+void graphics_hud_rtt (graphics_world *world, double rtt);
+
+
+/*
+  Draws the newest segment of user_points onto the stroke overlay and
+  invalidates only the bounding box of that segment, so the cost of a motion
+  event does not grow with the length of the stroke.  Called after every point
+  appended to user_points.
+
+  Parameters:
+      graphics_world *world - pointer to the graphics_world struct
+
+  Returns: nothing
+ */
+void graphics_stroke_append (graphics_world *world);
+
+
+/*
+  Clears the stroke overlay once the player releases the button or the
+  user_points are thrown away.
+
+  Parameters:
+      graphics_world *world - pointer to the graphics_world struct
+
+  Returns: nothing
+ */
+void graphics_stroke_clear (graphics_world *world);
+
+
 #endif
@@ -0,0 +1,101 @@
+#ifndef INPUTLOG_H
+#define INPUTLOG_H
+
+#include <stdint.h>
+
+/*
+  Log of every input that changes the world of a server, so that a round can
+  be played again by the replay tool.  The physics is deterministic for a
+  given build, so replaying the same inputs at the same ticks gives the same
+  world; the server also records an outcome, a checksum of every body, each
+  time a round ends, which the replay compares with its own.  A log is a text
+  file that starts with a DZLOG version timestep line, followed by one event
+  per line:
+
+      LEVEL tick level              a world of level was built or reset
+      BODY tick color mass n x y... a player drew a polygon of n points
+      ITERATIONS tick n             the solver iterations were changed
+      OUTCOME tick level status checksum   the round ended in this state
+
+  A tick is the number of world steps the server had taken when the event
+  happened.  Floating point numbers are written in hexadecimal so that they
+  read back exactly.
+ */
+
+#define INPUT_LOG_VERSION 1
+
+typedef enum {
+
+	INPUT_LEVEL = 0,
+	INPUT_BODY,
+	INPUT_ITERATIONS,
+	INPUT_OUTCOME
+
+} input_kind;
+
+typedef struct {
+    input_kind kind;
+    long tick;
+    int level; // LEVEL and OUTCOME
+    int iterations; // ITERATIONS
+    int status; // OUTCOME
+    uint64_t checksum; // OUTCOME
+    COLOR color; // BODY
+    cpFloat mass; // BODY
+    int vector_count; // BODY
+    cpVect *vectors; // BODY, in world coordinates
+    int vector_capacity;
+} input_event;
+
+/*
+  Creates a log and writes its first line.
+
+  Parameters:
+      *filename = file to write, replaced if it exists
+      timestep = time of one world step
+
+  Returns: the file, or NULL if it cannot be created
+ */
+FILE *input_log_open (const char *filename, float timestep);
+
+void input_log_level (FILE *log, long tick, int level);
+
+void input_log_body (FILE *log, long tick, COLOR color, cpFloat mass, cpVect *vectors, int vector_count);
+
+void input_log_iterations (FILE *log, long tick, int iterations);
+
+/*
+  Records the state a round ended in: its status and the checksum of its
+  bodies.
+ */
+void input_log_outcome (FILE *log, long tick, world_status *world);
+
+/*
+  Opens a log for reading and checks its first line.
+
+  Parameters:
+      *timestep = set to the time of one world step of the log
+
+  Returns: the file, or NULL if it cannot be read or is not a log of this
+  version
+ */
+FILE *input_log_read_open (const char *filename, float *timestep);
+
+/*
+  Reads the next event.  The vectors of a BODY event are kept in the event
+  and reused by the next read; event must be zeroed before the first read and
+  released with input_event_free.
+
+  Returns: false at the end of the log or on a line that cannot be read
+ */
+bool input_log_read (FILE *log, input_event *event);
+
+void input_event_free (input_event *event);
+
+/*
+  Hash of the position and angle of every body of the world by id, which
+  is the same only for worlds that went through exactly the same steps.
+ */
+uint64_t world_checksum (world_status *world);
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <stdint.h>
+
+/*
+  Compiled level format.  A .lvlb file is produced from a .lvl text file by
+  levelc and holds, back to back:
+
+      level_header
+      level_body    bodies[body_count]
+      cpVect        vertices[vertex_count]
+
+  Every body already carries its position, moment and bounding box, and its
+  outline vertices are relative to its position, so world_new can build the
+  bodies straight out of the mapped file without any parsing or arithmetic.
+  Files are written in the byte order and cpFloat size of the machine that
+  compiled them; level_map rejects anything else, and anything older than the
+  .lvl it was compiled from, so the text file is used instead.
+ */
+
+#define LEVEL_MAGIC "DZLV"
+#define LEVEL_VERSION 7
+
+typedef enum {
+
+	LEVEL_BOX = 0,
+	LEVEL_LINE,
+	LEVEL_CUSTOM,
+	LEVEL_GROUND
+
+} level_shape;
+
+/*
+  How a level body moves.  Static bodies are rogue static bodies that never
+  move; kinematic bodies are rogue bodies of infinite mass that keep moving
+  with the velocity given in the level, pushing whatever is in their way;
+  dynamic bodies are simulated.  Set in the .lvl file by the STATIC,
+  KINEMATIC vx vy w and DYNAMIC keywords, which apply to every body that
+  follows them, like TARGET and OBSTACLE.
+ */
+typedef enum {
+
+	LEVEL_DYNAMIC = 0,
+	LEVEL_STATIC,
+	LEVEL_KINEMATIC
+
+} level_mode;
+
+/*
+  Sleeping thresholds used unless the level has a SLEEP time speed line.
+  A time of zero or less in the file turns sleeping off for the level.
+ */
+#define LEVEL_SLEEP_TIME 0.5f
+#define LEVEL_IDLE_SPEED 0.0f
+
+/*
+  Time every dynamic body has to be at rest before world_update declares the
+  round settled, unless the level has a SETTLE time line.
+ */
+#define LEVEL_SETTLE_TIME 1.0f
+
+/*
+  Spatial index of the space.  By default physics.c picks one from the sizes
+  of the level's shapes; INDEX TREE or INDEX HASH dim count in the .lvl file
+  forces one, with a dim or count of 0 for the automatic value.
+ */
+typedef enum {
+
+	LEVEL_INDEX_AUTO = 0,
+	LEVEL_INDEX_TREE,
+	LEVEL_INDEX_HASH
+
+} level_index;
+
+/*
+  Solver settings used unless the level has GRAVITY x y, ITERATIONS n,
+  SLOP distance, BIAS fraction or DAMPING fraction lines.  A bias of 0 keeps
+  Chipmunk's default of correcting 10% of the overlap every 1/60 s.
+ */
+#define LEVEL_GRAVITY_X 0.0f
+#define LEVEL_GRAVITY_Y -75.0f
+#define LEVEL_ITERATIONS 10
+#define LEVEL_COLLISION_SLOP 0.1f
+#define LEVEL_COLLISION_BIAS 0.0f
+#define LEVEL_DAMPING 1.0f
+
+// kept a multiple of 8 bytes long, so that the cpFloats after it are aligned
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t float_size; // sizeof(cpFloat) the file was compiled with
+    uint32_t body_count;
+    uint32_t vertex_count;
+    uint32_t drawing_box;
+    float drawing_box_x1;
+    float drawing_box_y1;
+    float drawing_box_x2;
+    float drawing_box_y2;
+    float sleep_time; // seconds at rest before a body sleeps, INFINITY for never
+    float idle_speed; // speed under which a body is at rest, 0 to derive it from gravity
+    float settle_time; // seconds every body has to be at rest before the round is over
+    uint32_t index; // level_index
+    float index_dim; // spatial hash cell size, 0 for automatic
+    uint32_t index_count; // spatial hash cell count, 0 for automatic
+    float gravity_x;
+    float gravity_y;
+    uint32_t iterations;
+    float collision_slop;
+    float collision_bias; // overlap left after one second, 0 for Chipmunk's default
+    float damping; // velocity kept after one second
+} level_header;
+
+/*
+  One body of the level in file order, which is also body id order.  The
+  vertices are the outline of the body, joined into a closed chain of
+  segments; lines and the ground have two of them.  Ground vertices are in
+  world coordinates because they belong to the static body.
+ */
+typedef struct {
+    uint32_t shape; // level_shape
+    uint32_t collision;
+    uint32_t color;
+    uint32_t vertex_offset;
+    uint32_t vertex_count;
+    uint32_t mode; // level_mode
+    cpFloat mu;
+    cpFloat mass;
+    cpFloat moment;
+    cpVect center;
+    cpBB bb; // world space, including the segment radius
+    cpVect velocity; // kinematic bodies only
+    cpFloat angular_velocity;
+} level_body;
+
+typedef struct {
+    level_header *header;
+    level_body *bodies;
+    cpVect *vertices;
+    void *mapping; // whole file when mapped, NULL when parsed from text
+    size_t mapping_size;
+} level_data;
+
+/*
+  Parses a .lvl text file into level descriptors.
+
+  Parameters:
+      *ifile = text file to read
+
+  Returns: the level, to be released with level_free
+ */
+level_data *level_parse (FILE *ifile);
+
+/*
+  Maps a compiled .lvlb file read-only.
+
+  Parameters:
+      *filename = compiled level
+      *source = text level it was compiled from, or NULL to skip the age check
+
+  Returns: the level, or NULL if the file is missing, invalid, compiled for a
+  different version or cpFloat size, or older than *source
+ */
+level_data *level_map (const char *filename, const char *source);
+
+/*
+  Loads level number level, from levelN.lvlb if a usable one exists and from
+  levelN.lvl otherwise.
+
+  Returns: the level, or NULL if neither file can be read
+ */
+level_data *level_load (int level);
+
+/*
+  Writes a level in the compiled format.
+
+  Returns: true if the whole file was written
+ */
+bool level_write (level_data *level, const char *filename);
+
+void level_free (level_data *level);
+
+#endif
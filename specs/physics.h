@@ -7,14 +7,46 @@
 #ifndef PHYSICS_H
 #define PHYSICS_H
 
+#include <stdbool.h>
+#include "profile.h"
 
+// most sub-steps world_update splits one step into
+#define WORLD_MAX_SUBSTEPS 8
+
+
+/*
+  Every body of a world by id, in parallel arrays so that the snapshot, delta
+  and settle passes are plain loops over them.  Ids below level_body_count
+  belong to the level, in file order, and the rest were drawn by players.  The
+  body is NULL for the ground, which is the space's static body, and for
+  bodies removed for leaving the level bounds.  The sent_* arrays hold what
+  was last sent to the clients and are kept by protocol_send_coords, and
+  removed is set for the bodies removed since the clients were last told,
+  which protocol_send_removals clears.
+ */
+typedef struct {
+	int count;
+	int capacity;
+	cpBody **body;
+	COLOR *color;
+	cpVect *sent_pos;
+	cpFloat *sent_angle;
+	cpVect *sent_vel;
+	bool *removed;
+} body_registry;
 
 /*
   The reason for this struct is so that the GUI can have both a pointer to the
   cpSpace (to give to graphics) and know the status of the game (whether the
   player has won, lost, or the game is still being played).  The drawing_box_*
   variables are passed to GUI so that the GUI can create the drawing box and send
-  that information to graphics.
+  that information to graphics.  bodies holds every body of the world by id;
+  a level body that left the bounds stays out of it until the level is
+  reset.  The round is settled once every dynamic body has been at rest for settle_time
+  seconds, and stays so until a body is added or the world is reset.  Each
+  update is split into sub-steps when the fastest body could otherwise pass
+  through the thinnest shape; substep_counts[n] counts the updates that took
+  n of them.
  */
 
 typedef struct {
@@ -27,6 +59,23 @@ typedef struct {
     float drawing_box_y2;
     float timestep;
 	int body_count;
+	int level;
+	int level_body_count;
+	body_registry bodies;
+	cpBB bounds;
+	bool spatial_hash;
+	int iterations; // solver iterations the level asks for
+	bool settled;
+	float rest_time;
+	float settle_time;
+	cpFloat min_thickness;
+	cpFloat max_speed; // of the fastest body after the last update
+	int substeps; // taken by the last update
+	long substep_counts[WORLD_MAX_SUBSTEPS + 1];
+	struct arena *arena; // owns the bodies, shapes and their information
+	size_t player_mark; // arena mark of the first player drawn body
+	profile_ring *profile; // set by world_set_profile, NULL by default
+	profile_sample sample; // of the last update while profiled, pushed by world_profile
 } world_status;
 
 /*
@@ -47,6 +96,47 @@ typedef struct {
  */
 world_status *world_new(int level, float timestep);
 
+/*
+  Restarts the level of the world without rebuilding it: removes every player
+  drawn body and releases its memory by rewinding the world's arena, puts the
+  level bodies back in their initial poses at rest and awake, and sets the
+  status back to playing.  If a level body left the bounds, the level is
+  built again from its template instead.  Must not be called while the space
+  is being stepped.
+
+  Parameters: world- the world to restart
+ */
+void world_reset (world_status *world);
+
+/*
+  Boxes, lines, the ground and convex outlines are built from one native
+  shape each.  Passing true makes later worlds use the segment outlines of
+  earlier versions instead (four segments per box, two per line); only
+  step_bench uses it, to compare the two.
+ */
+void world_use_segment_shapes (bool enabled);
+
+/*
+  Each world picks its spatial index when it is built: the one its level asks
+  for, or else a spatial hash sized from its shapes if they are many and of
+  similar size, and the bounding box tree otherwise; spatial_hash tells which.
+  Passing LEVEL_INDEX_TREE or LEVEL_INDEX_HASH makes later worlds use that one
+  instead, and LEVEL_INDEX_AUTO goes back to the levels' choice; only
+  step_bench uses it.
+ */
+void world_use_spatial_index (int index);
+
+/*
+  Reads every level (level1 up to the first missing one) into templates kept
+  for the rest of the program, which world_new builds worlds from.  Levels
+  that were not loaded here are loaded the first time world_new needs them.
+  Also turns on the collisions between segments in Chipmunk, which is global,
+  so it must be called once at startup, before the first world_new.
+
+  Returns: number of levels loaded
+ */
+int world_load_levels (void);
+
 
 /*
   Takes two points from the GUI and adds the box defined by that diagonal as a
@@ -70,17 +160,74 @@ world_status *world_new(int level, float timestep);
 void world_add_object(world_status *world, cpVect vector, cpFloat width, cpFloat
 		      height, COLOR color, cpCollisionType collision);
 
+/*
+  Adds a player drawn polygon (in world coordinates) as a dynamic body.  Simple
+  outlines are split into convex polygon shapes and the body is placed at
+  their centroid with their moment of inertia; outlines that cross themselves
+  become a chain of segments around the vertex average.  The outline relative
+  to the body position is kept in its body_information.
+
+  Returns: the body id
+ */
 int
 create_user_object (cpVect *vectors, int vector_size, COLOR color, world_status *world, cpCollisionType collision, cpFloat mu, cpFloat mass);
 
+/*
+  Saves the state of a world into a buffer: the level, the position,
+  velocity, angle, angular velocity and sleep state of every body, and the
+  outline, color, mass, friction and collision type of every player drawn
+  body, so that the world can be put back in that state with world_restore.
+  The snapshot is only meant for worlds of the same build of the program.
+
+  Parameters:
+      *buffer = where to write the snapshot
+      size = bytes available; 0 just to get the size needed
+
+  Returns: bytes the snapshot takes; nothing is written if that is more than
+  size
+ */
+size_t world_snapshot (world_status *world, void *buffer, size_t size);
+
+/*
+  Puts a world back in the state saved by world_snapshot.  When the world
+  still has the bodies of the snapshot, which is the case when restoring over
+  and over to try things out from the same point, only their states are
+  written; otherwise the world is reset and the player bodies of the snapshot
+  are drawn again with their ids.  Contact history is not saved, so a
+  restored world is not guaranteed to step exactly like the original.  Must
+  not be called while the space is being stepped.
+
+  Returns: false, leaving the world as it was, if the snapshot is of another
+  level than the world's or is cut short
+ */
+bool world_restore (world_status *world, const void *buffer, size_t size);
+
+/*
+  Finds a body by its id.
+
+  Returns: the body, or NULL if the world has none with that id
+ */
+cpBody *world_get_body (world_status *world, int body_id);
+
+/*
+  Center (vertex average) and moment (of the circle with the mean vertex
+  distance as radius) used for custom and player drawn bodies.  Also used by
+  the level compiler, so that compiled levels match text levels exactly.
+ */
+cpVect center_calculation (cpVect *vectors, int vector_size);
+
+cpFloat moment_calculation (cpVect *vectors, int vector_size, cpVect center, cpFloat mass);
+
 /*
   Called by the GUI at regular time intervals to advance time in the cpSpace.
-  This function checks whether all bodies have stopped moving, and if so alters
-  the status in world_status.  It returns the world_status so that the GUI and
-  graphics can know when the game is over and where all the bodies in the space
-  are.  If all boxes have stopped moving, then the status of the game is updated.
-  If a box has moved off the screen, it is deleted from the space.  Called by
-  gui.c
+  This function checks whether all bodies have stopped moving, and once they
+  have been at rest for the settle time of the level it sets settled in
+  world_status; a settled world is not stepped any more until a body is added
+  or the world is reset.  If a body has moved out of the level bounds, it is
+  removed from the space after the step.  If the world has a profile ring,
+  the time spent in cpSpaceStep, the sleeping bodies and the bodies removed
+  after the step are kept in its sample for world_profile.  Called by gui.c
+  and the server.
 
   Parameters: world- the latest status of the world so that a new status can be calculated
 
@@ -88,12 +235,27 @@ create_user_object (cpVect *vectors, int vector_size, COLOR color, world_status
  */
 void *world_update(world_status *world);
 
+/*
+  Sets the ring a world is profiled into, NULL to stop.  A profiled space
+  keeps its contact graph enabled, without which Chipmunk only links the
+  contact pairs to the bodies in levels that sleep.
+ */
+void world_set_profile (world_status *world, profile_ring *ring);
+
+/*
+  Counts the awake bodies and contact pairs of a profiled world and pushes
+  the sample of its last update; does nothing if it is not profiled.  Kept
+  out of world_update so that whoever times the update can leave the count
+  out.
+ */
+void world_profile (world_status *world);
+
 cpBody *world_get_ground (cpSpace *space);
 
 
 /*
-  Frees all the shapes, bodies, and static bodies to prevent memory leaks.
-  Called by gui.c
+  Frees the space and the arena that holds all the shapes, bodies, static
+  bodies and body information of the world.  Called by gui.c
 
   Parameters: none
 
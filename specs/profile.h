@@ -0,0 +1,117 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/*
+  Step profiler.  A world given a ring by world_set_profile pushes one
+  profile_sample per world_update into it, through world_profile; the ring has a single producer (the thread
+  stepping the world) and a single consumer (whoever calls profiler_drain),
+  and needs no lock between them.  Samples that find the ring full are
+  dropped and counted.  Draining folds the samples into histograms per level,
+  from which the median, 99th percentile and maximum of each figure are
+  printed.
+ */
+
+#define PROFILE_RING_SIZE 1024 // a power of two
+
+/*
+  Buckets of a histogram.  Bucket 0 holds values under 1, and every other
+  bucket a quarter of a power of two, so a percentile is read back to within
+  about 19% of the value; maxima are exact.
+ */
+#define PROFILE_BUCKETS 96
+
+typedef struct {
+    int level;
+    float step_time; // microseconds spent in cpSpaceStep, every sub-step included
+    int active_bodies; // awake bodies in the space after the step
+    int arbiters; // contact pairs after the step
+    int sleeping_bodies;
+    int post_step; // bodies removed after the step for leaving the level bounds
+} profile_sample;
+
+typedef struct profile_ring {
+    profile_sample samples[PROFILE_RING_SIZE];
+    unsigned head; // next sample to write, only moved by the producer
+    unsigned tail; // next sample to read, only moved by the consumer
+    long dropped; // only written by the producer
+} profile_ring;
+
+typedef struct {
+    long count;
+    long buckets[PROFILE_BUCKETS];
+    double max;
+} profile_histogram;
+
+typedef struct {
+    long steps; // 0 for levels that were never profiled
+    profile_histogram step_time;
+    profile_histogram active_bodies;
+    profile_histogram arbiters;
+    profile_histogram sleeping_bodies;
+    profile_histogram post_step;
+} profile_level;
+
+typedef struct {
+    profile_ring ring;
+    profile_level *levels; // indexed by level number
+    int level_capacity;
+} profiler;
+
+/*
+  Returns: an empty profiler, to be released with profiler_free
+ */
+profiler *profiler_new (void);
+
+void profiler_free (profiler *profiler);
+
+/*
+  Adds a sample to the ring; called by the producer only.
+
+  Returns: false if the ring was full and the sample dropped
+ */
+bool profile_push (profile_ring *ring, const profile_sample *sample);
+
+/*
+  Moves every sample in the ring into the histograms of its level; called by
+  the consumer only.
+
+  Returns: number of samples moved
+ */
+int profiler_drain (profiler *profiler);
+
+/*
+  Returns: the value under which fraction of the values of the histogram fall,
+  0 if it is empty
+ */
+double profile_percentile (profile_histogram *histogram, double fraction);
+
+/*
+  Prints the median, 99th percentile and maximum of every figure of every
+  profiled level.
+ */
+void profiler_print (profiler *profiler, FILE *file);
+
+/*
+  Writes profiler_print to a file, replacing it.
+
+  Returns: true if the file was written
+ */
+bool profiler_dump (profiler *profiler, const char *filename);
+
+/*
+  Returns: the current time of the monotonic clock, in microseconds
+ */
+double profile_now (void);
+
+/*
+  Counts the awake bodies and the contact pairs of a space.  The pairs are
+  found through the bodies, which Chipmunk only links them to when sleeping
+  or the contact graph of the space is enabled; world_set_profile enables it
+  for a profiled world, and any other space counts 0 pairs without either.
+ */
+void profile_space_counts (cpSpace *space, int *active_bodies, int *arbiters);
+
+#endif
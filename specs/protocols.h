@@ -1,5 +1,10 @@
 #ifndef PROTOCOLS
 #define PROTOCOLS
+
+#include <stdbool.h>
+#include "common.h"
+#include "physics.h" // world_status, for the server side functions
+
 #define MAX_COLOR_SIZE 7
 #define MAX_COORDINATE_SIZE 50
 #define MAXLINE 400
@@ -9,6 +14,8 @@
 #define CHAT_MESSAGE 3
 #define ZONE_MESSAGE 4
 #define LEVEL_MESSAGE 5
+#define PING_MESSAGE 6
+#define REMOVE_BODY_MESSAGE 7
 #define BEGIN_CHARACTER "~!@"
 #define ID_INDEX 4
 #define END_CHARACTER "?`."
@@ -30,6 +37,7 @@ typedef struct {
 typedef struct {
 	float *angle_array;
 	cpVect *vector_array;
+	int count; // length of both arrays
 } coord_update;
 
 typedef struct {
@@ -65,13 +73,19 @@ char *protocol_send_zone(float x1, float y1, float x2, float y2);
 
 drawing_zone *protocol_decode_zone(char *string);
 
+char *protocol_send_ping(double time);
+
+double protocol_decode_ping(char *message);
+
 
 /* server side functions */
 
 
 char *protocol_new_body ( char *color, cpVect *array, int vector_count, int id, float mass );
 
-char *protocol_send_coords( cpSpace *space );
+char *protocol_send_coords( world_status *world, bool full, int *next );
+
+char *protocol_send_removals( world_status *world, int *next );
 
 polygon_struct *protocol_extract_body( char *string );
 
@@ -85,4 +99,6 @@ char *ctos_convert( char *color, float *array, int int_count );
 
 coord_update *protocol_extract_coords( char *string );
 
+int *protocol_extract_removals( char *string, int *count );
+
 #endif
@@ -0,0 +1,263 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <chipmunk/chipmunk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "specs/common.h"
+#include "specs/physics.h"
+#include "specs/level.h"
+
+#define DEFAULT_STEPS 600
+#define PLAYER_BODIES 3
+#define PLAYER_SIZE 3
+
+/*
+	step_bench.c
+
+	headless physics benchmark. Builds every level twice,
+	once from segment outlines as earlier versions did and
+	once from native shapes, drops the same few player
+	boxes into the drawing zone, and times every
+	world_update. The levels never settle, so that every
+	timed update steps the space whichever build comes to
+	rest first. Prints the shape count, mean and p99
+	step time of both and the speedup per level, and the
+	mean and largest number of sub-steps of an update.
+
+	With -i, both builds use native shapes and the first
+	uses the bounding box tree, the second the spatial
+	hash; the index each level picks by itself is printed
+	too.
+
+	usage: step_bench [-i] [steps]
+ */
+
+typedef struct {
+	int shapes;
+	bool spatial_hash;
+	double mean;
+	double p99;
+	double substeps;
+	int max_substeps;
+} bench_result;
+
+//function prototypes
+static double bench_now (void);
+static int bench_compare (const void *a, const void *b);
+static void bench_count_shape (cpShape *shape, void *data);
+static bench_result bench_level (int level, int steps, bool segments, int index, double *times);
+
+/*
+	returns the current time of the monotonic clock
+
+	Parameters: none
+
+	Returns: time in seconds
+ */
+static double
+bench_now (void) {
+
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+	qsort comparator for step times
+
+	Parameters: pointers to two doubles
+
+	Returns: negative, zero or positive like strcmp
+ */
+static int
+bench_compare (const void *a, const void *b) {
+
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+	counts one shape of the space
+
+	Parameters:
+		*shape = shape of the space
+		*data = int counter
+
+	Returns: nothing
+ */
+static void
+bench_count_shape (cpShape *shape, void *data) {
+
+	(*(int *)data)++;
+}
+
+/*
+	builds one level, drops the player boxes and steps it
+
+	Parameters:
+		level = level number to load
+		steps = number of steps to time
+		segments = true to build the level from segments only
+		index = level_index to force, LEVEL_INDEX_AUTO for the
+			level's own choice
+		*times = scratch array of at least steps doubles
+
+	Returns: shape count and step time statistics
+ */
+static bench_result
+bench_level (int level, int steps, bool segments, int index, double *times) {
+
+	bench_result result;
+	cpFloat time_step = 1.0/60.0;
+
+	world_use_segment_shapes (segments);
+	world_use_spatial_index (index);
+	world_status *world = world_new (level, time_step);
+	result.spatial_hash = world->spatial_hash;
+
+	// a settled world returns from world_update without stepping
+	world->settle_time = INFINITY;
+
+	cpVect drop = cpv(0, 10);
+	if (world->drawing_box)
+		drop = cpv((world->drawing_box_x1 + world->drawing_box_x2) / 2,
+				   (world->drawing_box_y1 + world->drawing_box_y2) / 2);
+
+	for (int i = 0; i < PLAYER_BODIES; i++) {
+
+		cpVect center = cpvadd (drop, cpv((i - 1) * (PLAYER_SIZE + 1), i * (PLAYER_SIZE + 1)));
+		cpVect square[4] = {
+			cpvadd (center, cpv(-PLAYER_SIZE / 2.0, PLAYER_SIZE / 2.0)),
+			cpvadd (center, cpv(PLAYER_SIZE / 2.0, PLAYER_SIZE / 2.0)),
+			cpvadd (center, cpv(PLAYER_SIZE / 2.0, -PLAYER_SIZE / 2.0)),
+			cpvadd (center, cpv(-PLAYER_SIZE / 2.0, -PLAYER_SIZE / 2.0))
+		};
+
+		create_user_object (square, 4, RED, world, PLAYER_BOX_COLLISION_NUMBER, 1, 1);
+	}
+
+	result.shapes = 0;
+	cpSpaceEachShape (world->space, bench_count_shape, &result.shapes);
+
+	double total = 0;
+
+	for (int step = 0; step < steps; step++) {
+
+		double start = bench_now ();
+		world_update (world);
+		times[step] = bench_now () - start;
+		total += times[step];
+	}
+
+	qsort (times, steps, sizeof(double), bench_compare);
+
+	int p99 = (steps * 99) / 100;
+	if (p99 >= steps)
+		p99 = steps - 1;
+
+	result.mean = total / steps;
+	result.p99 = times[p99];
+
+	long updates = 0, substeps = 0;
+	result.max_substeps = 0;
+
+	for (int n = 1; n <= WORLD_MAX_SUBSTEPS; n++) {
+
+		updates += world->substep_counts[n];
+		substeps += n * world->substep_counts[n];
+
+		if (world->substep_counts[n] > 0)
+			result.max_substeps = n;
+	}
+
+	result.substeps = (updates > 0) ? (double)substeps / updates : 0;
+
+	world_free (world);
+
+	return result;
+}
+
+/*
+	main function, benchmarks every level in both modes
+
+	parameters: optional -i to compare the spatial indexes,
+		optional step count
+ */
+int
+main (int argc, char *argv[]) {
+
+	int steps = DEFAULT_STEPS;
+	bool compare_index = false;
+	int arg = 1;
+
+	if (arg < argc && strcmp (argv[arg], "-i") == 0) {
+		compare_index = true;
+		arg++;
+	}
+
+	if (arg < argc)
+		steps = atoi (argv[arg]);
+
+	if (steps < 1) {
+		printf("usage: step_bench [-i] [steps]\n");
+		exit(-1);
+	}
+
+	double *times = (double *)malloc(steps * sizeof(double));
+	if (times == NULL) {
+		printf("Memory allocation error: in function main\n");
+		exit(-1);
+	}
+
+	int levels = world_load_levels ();
+
+	printf("%d steps per level, times in microseconds\n", steps);
+
+	if (compare_index)
+		printf("level |     tree: shapes   mean    p99 |   hash: shapes   mean    p99 | speedup | sub-steps | auto\n");
+	else
+		printf("level | segments: shapes   mean    p99 | native: shapes   mean    p99 | speedup | sub-steps\n");
+
+	for (int level = 1; level <= levels; level++) {
+
+		bench_result before, after;
+
+		if (compare_index) {
+			before = bench_level (level, steps, false, LEVEL_INDEX_TREE, times);
+			after = bench_level (level, steps, false, LEVEL_INDEX_HASH, times);
+		}
+		else {
+			before = bench_level (level, steps, true, LEVEL_INDEX_AUTO, times);
+			after = bench_level (level, steps, false, LEVEL_INDEX_AUTO, times);
+		}
+
+		printf("%5d |          %6d %6.1f %6.1f |        %6d %6.1f %6.1f | %6.2fx", level,
+			   before.shapes, 1e6 * before.mean, 1e6 * before.p99,
+			   after.shapes, 1e6 * after.mean, 1e6 * after.p99,
+			   before.mean / after.mean);
+
+		printf(" | %4.2f %4d", after.substeps, after.max_substeps);
+
+		if (compare_index) {
+			world_use_spatial_index (LEVEL_INDEX_AUTO);
+			world_status *world = world_new (level, 1.0/60.0);
+			printf(" | %s", world->spatial_hash ? "hash" : "tree");
+			world_free (world);
+		}
+
+		printf("\n");
+	}
+
+	world_use_segment_shapes (false);
+	world_use_spatial_index (LEVEL_INDEX_AUTO);
+	free (times);
+
+	return 0;
+}